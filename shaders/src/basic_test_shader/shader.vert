@@ -1,7 +1,46 @@
 #version 450 core
 
+#if defined(USE_VERTEX_PULLING)
+#extension GL_ARB_shader_draw_parameters : require
+
+// NOTE: record per quad, layout matches ve001::packVertex (position is the quad's
+// origin and texcoord is its logical extent)
+layout(std430, binding = 9) readonly buffer QuadsData {
+    uvec2 quads[];
+};
+// NOTE: indexed by draw command's base instance (chunk id)
+layout(std430, binding = 10) readonly buffer ChunkOrigins {
+    float chunk_origins[];
+};
+
+const vec3 VERTICES[8] = {
+    vec3(0.0, 0.0, 0.0), // 0
+    vec3(0.0, 0.0, 1.0), // 1
+    vec3(0.0, 1.0, 0.0), // 2 
+    vec3(0.0, 1.0, 1.0), // 3
+    vec3(1.0, 0.0, 0.0), // 4
+    vec3(1.0, 0.0, 1.0), // 5
+    vec3(1.0, 1.0, 0.0), // 6
+    vec3(1.0, 1.0, 1.0)  // 7
+};
+const uint QUADS[6][4] = {
+    { 5, 4, 6, 7 },
+    { 0, 1, 3, 2 },
+    { 2, 3, 7, 6 },
+    { 4, 5, 1, 0 },
+    { 1, 5, 7, 3 },
+    { 4, 0, 2, 6 }
+};
+// NOTE: same pattern as indices of ibo used without vertex pulling
+const uint QUAD_CORNERS[6] = { 0, 1, 2, 0, 2, 3 };
+#elif defined(USE_PACKED_VERTEX)
+layout(location = 0) in uvec2 in_packed_vertex;
+// NOTE: instanced attribute, selected by draw command's base instance
+layout(location = 2) in vec3 in_chunk_origin;
+#else
 layout(location = 0) in vec3 in_position;
 layout(location = 1) in vec3 in_texcoord;
+#endif
 
 layout(std140, binding = 0) uniform General {
     mat4 vp;
@@ -13,15 +52,51 @@ layout(location = 1) flat out vec3 out_normal;
 layout(location = 2) out vec3 out_position;
 
 void main() {
-  
+#if defined(USE_VERTEX_PULLING)
+    uvec2 quad = quads[gl_VertexID / 6];
+    uint corner = QUAD_CORNERS[gl_VertexID % 6];
+
+    int face = int((quad.x >> 21) & 0x7u);
+    int voxel_value = int(quad.y & 0xFFFFu);
+
+    uint axis = uint(face) / 2u;
+    uvec3 logical_indices = uvec3((axis + 1u) % 3u, (axis + 2u) % 3u, axis);
+    vec3 region_extent = vec3(0.0);
+    region_extent[logical_indices[2]] = 1.0;
+    region_extent[logical_indices[1]] = float((quad.y >> 23) & 0x7Fu);
+    region_extent[logical_indices[0]] = float((quad.y >> 16) & 0x7Fu);
+
+    vec3 chunk_origin = vec3(
+        chunk_origins[gl_BaseInstanceARB * 3 + 0],
+        chunk_origins[gl_BaseInstanceARB * 3 + 1],
+        chunk_origins[gl_BaseInstanceARB * 3 + 2]
+    );
+    vec3 position = chunk_origin + vec3(
+        quad.x & 0x7Fu,
+        (quad.x >> 7) & 0x7Fu,
+        (quad.x >> 14) & 0x7Fu
+    ) + region_extent * VERTICES[QUADS[face][corner]];
+#elif defined(USE_PACKED_VERTEX)
+    // NOTE: layout matches ve001::packVertex
+    vec3 position = in_chunk_origin + vec3(
+        in_packed_vertex.x & 0x7Fu,
+        (in_packed_vertex.x >> 7) & 0x7Fu,
+        (in_packed_vertex.x >> 14) & 0x7Fu
+    );
+    int face = int((in_packed_vertex.x >> 21) & 0x7u);
+    int voxel_value = int(in_packed_vertex.y & 0xFFFFu);
+#else
+    vec3 position = in_position;
     int face = int(in_texcoord.z) % 6;
+    int voxel_value = int(in_texcoord.z) / 6 + 1;
+#endif
     vec3 normal = vec3(0.0);
     normal[face / 2] = 1.0 + (float(face % 2) * -2.0);
     out_normal = normal;
 
-    out_color_id = (int(in_texcoord.z) / 6) % 9;
+    out_color_id = (voxel_value - 1) % 9;
 
-    out_position = in_position;
+    out_position = position;
     
-    gl_Position = vp * vec4(in_position, 1.0);
+    gl_Position = vp * vec4(position, 1.0);
 }
@@ -1,70 +1,170 @@
 #include "chunk_data_streamer.h"
+#include "task_pool.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 using namespace ve001;
 using namespace vmath;
 
+/// @brief source of unique streamers' ids
+static std::atomic_uint64_t s_next_streamer_id{ 1UL };
+/// @brief id of the streamer for which the generator was initialized on calling thread
+static thread_local u64 tl_initialized_streamer_id{ 0UL };
+
+/// @brief orders <_gen_promises> so that the lowest priority value is on the top of the heap
+static bool lowerPriority(const ChunkDataStreamer::Promise& lhs, const ChunkDataStreamer::Promise& rhs) noexcept {
+    return lhs.priority > rhs.priority;
+}
+
 ChunkDataStreamer::ChunkDataStreamer(EngineContext& engine_context, u32 threads_count, std::unique_ptr<ChunkGenerator> chunk_generator, std::size_t capacity) noexcept
-    : _engine_context(engine_context), _chunk_generator(std::move(chunk_generator)) {
+    : _engine_context(engine_context), _id(s_next_streamer_id++), _chunk_generator(std::move(chunk_generator)) {
+
+    _max_jobs_count = threads_count == 0U ?
+        std::numeric_limits<u32>::max() : threads_count;
 
     try {
-        _gen_promises.resize(capacity);
+        _gen_promises.reserve(capacity);
+        _results.resize(capacity);
     } catch(const std::exception&) {
         _engine_context.error |= Error::CPU_ALLOCATION_FAILED;
+        _done = true;
         return;
     }
+}
 
-    try {
-        auto final_threads_count = threads_count;
-        if (final_threads_count == 0U) {
-            final_threads_count = std::thread::hardware_concurrency() == 0 ? 1 : std::thread::hardware_concurrency();
-        }
-        for (std::uint32_t i{ 0U }; i < final_threads_count; ++i) {
-			auto t = std::jthread(&ChunkDataStreamer::thread, this);
-            _threads.push_back(std::move(t));
-        }
-    } catch(const std::exception&) {
-        _engine_context.error |= Error::CHUNK_DATA_STREAMER_THREAD_ALLOCATION_FAILED;
-        _done = true;
+f32 ChunkDataStreamer::priority(Vec3i32 chunk_position) const noexcept {
+    const auto chunk_size = Vec3f32::cast(_engine_context.chunk_size);
+    const auto position = Vec3f32::mul(Vec3f32::cast(chunk_position), chunk_size);
+    const auto diff = Vec3f32::sub(position, _focus.position);
+    const auto distance = diff[0]*diff[0] + diff[1]*diff[1] + diff[2]*diff[2];
+    if (!_focus.use_frustum) {
+        return distance;
     }
+
+    // NOTE: chunk is approximated by its bounding sphere, view space looks along -z
+    const auto radius = .5F * std::sqrt(chunk_size[0]*chunk_size[0] + chunk_size[1]*chunk_size[1] + chunk_size[2]*chunk_size[2]);
+    const auto position_in_view_space = Mat4f32::mulVec(_focus.view_matrix, {position[0], position[1], position[2], 1.F});
+    const auto depth = position_in_view_space[2];
+    const bool in_frustum =
+        depth - radius <= _focus.z_near && depth + radius >= _focus.z_far &&
+        std::abs(position_in_view_space[0]) - radius <= _focus.x_near * depth / _focus.z_near &&
+        std::abs(position_in_view_space[1]) - radius <= _focus.y_near * depth / _focus.z_near;
+
+    return in_frustum ? distance : distance * OUT_OF_FRUSTUM_PRIORITY_FACTOR;
 }
 
-void ChunkDataStreamer::thread() noexcept {
-    if (_done) {
-        return;
-    }
-    if (_chunk_generator->threadInit()) {
-		if (!_done) {
-        	_done = true;
-        	_engine_context.error |= Error::CHUNK_DATA_STREAMER_THREAD_INITIALIZATION_FAILED;
-		}
-        return;
+void ChunkDataStreamer::reprioritize() noexcept {
+    for (auto& promise : _gen_promises) {
+        promise.priority = priority(promise.position);
     }
+    std::make_heap(_gen_promises.begin(), _gen_promises.end(), lowerPriority);
+}
+
+void ChunkDataStreamer::updateFocus(Vec3f32 position) noexcept {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _focus.position = position;
+    reprioritize();
+}
 
-    ++_ready_counter;
+void ChunkDataStreamer::updateFrustumFocus(f32 z_near, f32 z_far, f32 x_near, f32 y_near, Mat4f32 view_matrix) noexcept {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _focus.use_frustum = true;
+    _focus.z_near = z_near;
+    _focus.z_far = z_far;
+    _focus.x_near = x_near;
+    _focus.y_near = y_near;
+    _focus.view_matrix = view_matrix;
+    reprioritize();
+}
 
-    while (!_done) {
-        Promise promise;
-        if (_gen_promises.read(promise)) {
-            // can throw but will never happen in practice
-            promise.value.set_value(_chunk_generator->gen(promise.position));
+void ChunkDataStreamer::postJob() noexcept {
+    _engine_context.task_pool.post(TASK_LANE_GENERATION, TaskPool::Task{
+        .function = [](void* data, std::size_t) noexcept {
+            static_cast<ChunkDataStreamer*>(data)->job();
+        },
+        .data = static_cast<void*>(this)
+    });
+}
+
+void ChunkDataStreamer::job() noexcept {
+    Promise promise;
+    {
+        // NOTE: there is always a promise for a posted job
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::pop_heap(_gen_promises.begin(), _gen_promises.end(), lowerPriority);
+        promise = _gen_promises.back();
+        _gen_promises.pop_back();
+    }
+
+    if (!_done && tl_initialized_streamer_id != _id) {
+        if (_chunk_generator->threadInit()) {
+            _engine_context.error |= Error::CHUNK_DATA_STREAMER_THREAD_INITIALIZATION_FAILED;
+            _done = true;
         } else {
-            std::this_thread::yield();
+            tl_initialized_streamer_id = _id;
         }
     }
-}
 
-std::future<std::optional<std::span<const vmath::u16>>> ChunkDataStreamer::gen(Vec3i32 chunk_position) noexcept {
-    // can throw but will never happen in practice
-    std::promise<std::optional<std::span<const vmath::u16>>> promise;
-    std::future<std::optional<std::span<const vmath::u16>>> result(promise.get_future());
-    
-    /// will never return false since size == max chunks count
-    _gen_promises.write(std::move(promise), chunk_position);
+    // NOTE: data of cancelled chunk is dropped by the consumer
+    if (_done || _results.cancelled(promise.handle)) {
+        _results.complete(promise.handle, std::nullopt);
+    } else {
+        _results.complete(promise.handle, 
+            _chunk_generator->genCancellable(promise.position, _results.cancellationToken(promise.handle)));
+    }
 
-    return result;
+    bool post_next_job{ false };
+    {
+        // NOTE: job's slot is either passed to the next job or released,
+        // after release the streamer mustn't be accessed (it may be destroyed)
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_unclaimed_promises_count > 0U) {
+            --_unclaimed_promises_count;
+            post_next_job = true;
+        } else if (--_jobs_count == 0U) {
+            // NOTE: notified under the lock, destructor can't proceed until it's released
+            _jobs_finished_cond_var.notify_all();
+        }
+    }
+    if (post_next_job) {
+        postJob();
+    }
 }
 
+ChunkDataStreamer::Handle ChunkDataStreamer::gen(Vec3i32 chunk_position) noexcept {
+    /// will never fail since capacity == max chunks count
+    const auto handle = _results.acquire();
 
+    bool post_job{ false };
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        // NOTE: never reallocates since capacity == max chunks count
+        _gen_promises.push_back(Promise{
+            .handle = handle,
+            .position = chunk_position,
+            .priority = priority(chunk_position)
+        });
+        std::push_heap(_gen_promises.begin(), _gen_promises.end(), lowerPriority);
+        if (_jobs_count < _max_jobs_count) {
+            ++_jobs_count;
+            post_job = true;
+        } else {
+            ++_unclaimed_promises_count;
+        }
+    }
+    if (post_job) {
+        postJob();
+    }
+
+    return handle;
+}
 
+ChunkDataStreamer::~ChunkDataStreamer() noexcept {
+    _done = true;
+    // NOTE: posted jobs reference the streamer, wait until
+    // all of them are executed
+    std::unique_lock<std::mutex> lock(_mutex);
+    _jobs_finished_cond_var.wait(lock, [this] { return _jobs_count == 0U; });
+}
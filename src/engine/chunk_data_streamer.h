@@ -4,55 +4,111 @@
 #include <span>
 #include <thread>
 #include <atomic>
-#include <future>
+#include <mutex>
+#include <condition_variable>
 #include <optional>
 #include <memory>
+#include <vector>
 
 #include <vmath/vmath.h>
 
-#include "threadsafe_ringbuffer.h"
+#include "completion_slots.h"
 #include "engine_context.h"
 #include "chunk_generator.h"
 
 namespace ve001 {
 
+/// @brief generates chunks' voxel data with jobs posted to generation lane of
+/// engine's task pool. Requests are served in order of their priority, chunks
+/// closest to the focus (camera) and lying in its frustum are generated first
 struct ChunkDataStreamer {
+    using Results = CompletionSlots<std::optional<std::span<const vmath::u16>>>;
+    using Handle = Results::Handle;
+
     struct Promise {
-        std::promise<std::optional<std::span<const vmath::u16>>> value;
+        /// @brief slot to which the generated chunk is written
+        Handle handle;
         vmath::Vec3i32 position;
+        /// @brief the lower the sooner chunk is generated
+        vmath::f32 priority;
+    };
+    /// @brief state based on which requests are prioritized
+    struct Focus {
+        /// @brief real position of the camera
+        vmath::Vec3f32 position{ 0.F, 0.F, 0.F };
+        /// @brief if true chunks outside of the frustum are deprioritized,
+        /// fields below are valid only if it's set
+        bool use_frustum{ false };
+        vmath::f32 z_near;
+        vmath::f32 z_far;
+        vmath::f32 x_near;
+        vmath::f32 y_near;
+        vmath::Mat4f32 view_matrix;
     };
-    /// @brief counts number of threads' which are already
-    /// initialized
-    std::atomic_int32_t _ready_counter{ 0 };
+    /// @brief priority (squared distance) of chunks outside of the frustum is multiplied by
+    /// this factor, so they are treated as if they were twice as far as they are
+    static constexpr vmath::f32 OUT_OF_FRUSTUM_PRIORITY_FACTOR{ 4.F };
 
     EngineContext& _engine_context;
 
-    /// @brief threads' exit condition
+    /// @brief unique id of the streamer, used to initialize generator
+    /// once per each worker thread
+    vmath::u64 _id;
+    /// @brief jobs' exit condition
     std::atomic_bool _done{ false };
-    /// @brief allocated threads
-    std::vector<std::jthread> _threads;
-    /// @brief promise queue for generation task
-    ThreadSafeRingBuffer<Promise> _gen_promises{};
+    /// @brief max number of generation jobs executed at once
+    vmath::u32 _max_jobs_count;
+    /// @brief guards <_jobs_count>, <_unclaimed_promises_count>, <_gen_promises> and <_focus>
+    std::mutex _mutex;
+    /// @brief signaled when last job finishes
+    std::condition_variable _jobs_finished_cond_var;
+    /// @brief number of posted jobs which haven't yet finished
+    vmath::u32 _jobs_count{ 0U };
+    /// @brief number of promises for which no job was posted yet
+    vmath::u32 _unclaimed_promises_count{ 0U };
+    /// @brief priority queue of generation tasks, binary heap with the lowest
+    /// priority value on the top. Its capacity is reserved up front
+    std::vector<Promise> _gen_promises;
+    /// @brief current focus of the streamer
+    Focus _focus;
+    /// @brief slots of generation results, one per each chunk which can be
+    /// requested at once (capacity)
+    Results _results;
     /// @brief used chunk data generator ptr
     std::unique_ptr<ChunkGenerator> _chunk_generator;
 
+    /// @param threads_count max number of worker threads generating chunks at once,
+    /// if 0 then all of the task pool's workers can be used
     ChunkDataStreamer(EngineContext& engine_context, vmath::u32 threads_count, std::unique_ptr<ChunkGenerator> chunk_generator, std::size_t capacity) noexcept;
 
-    /// @brief threads' entry point
-    void thread() noexcept;
+    /// @brief computes priority of a chunk based on current focus
+    /// @param chunk_position discrete position of the chunk in chunk extents
+    vmath::f32 priority(vmath::Vec3i32 chunk_position) const noexcept;
+    /// @brief recomputes priorities of queued requests after the focus changed
+    void reprioritize() noexcept;
+    /// @brief moves focus to the new camera position and re-evaluates priorities of queued requests
+    /// @param position real position of the camera
+    void updateFocus(vmath::Vec3f32 position) noexcept;
+    /// @brief sets camera's frustum (same parameters as Engine::applyFrustumCullingPartition) used to
+    /// deprioritize chunks which aren't visible and re-evaluates priorities of queued requests
+    void updateFrustumFocus(vmath::f32 z_near, vmath::f32 z_far, vmath::f32 x_near, vmath::f32 y_near, vmath::Mat4f32 view_matrix) noexcept;
 
-    /// @brief signals if chunk data streamer was fully initialized
-    /// @return true if chunk data streamer is initialzed
-    bool ready() const noexcept { return _ready_counter == _threads.size(); }
+    /// @brief posts generation job to engine's task pool
+    void postJob() noexcept;
+    /// @brief generation job's entry point, generates the most prioritized chunk
+    /// and if there are unclaimed promises it posts next job
+    void job() noexcept;
 
     /**
      * @brief generates chunk
      * @param chunk_position discrete position of the chunk in chunk extents
-     * @return future to pointer to generated chunk, nullopt if chunk is all 0
+     * @return handle to slot in <_results> to which pointer to generated chunk is written (nullopt
+     * if chunk is all 0), the value has to be taken out with _results.get() to release the slot. Request
+     * can be cancelled with _results.cancel(), then generation is skipped or stopped early
     */
-    std::future<std::optional<std::span<const vmath::u16>>> gen(vmath::Vec3i32 chunk_position) noexcept;
+    Handle gen(vmath::Vec3i32 chunk_position) noexcept;
 
-    ~ChunkDataStreamer() noexcept { _done = true; }
+    ~ChunkDataStreamer() noexcept;
 
 };
 
@@ -3,6 +3,7 @@
 
 #include <span>
 #include <optional>
+#include <atomic>
 
 #include <vmath/vmath.h>
 
@@ -15,6 +16,14 @@ struct ChunkGenerator {
     /// @brief generates data at <chunk_position>
     /// @return generated data, if fails just return std::nullopt
     virtual std::optional<std::span<const vmath::u16>> gen(vmath::Vec3i32 chunk_position) noexcept = 0;    
+    /// @brief generates data at <chunk_position>, generation can be stopped early once
+    /// <cancellation_token> is set (chunk isn't needed anymore and its data is dropped). By
+    /// default token is ignored
+    /// @return generated data, any value if cancelled
+    virtual std::optional<std::span<const vmath::u16>> genCancellable(vmath::Vec3i32 chunk_position, 
+        [[maybe_unused]] const std::atomic_bool& cancellation_token) noexcept {
+        return gen(chunk_position);
+    }
 };
 
 }
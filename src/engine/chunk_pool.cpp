@@ -3,17 +3,53 @@
 #include <glad/glad.h>
 
 #include <cstring>
+#include <bit>
+#include <chrono>
+#include <cstdint>
 #include <iostream>
 
 using namespace ve001;
 using namespace vmath;
 
+#ifdef USE_VERTEX_PULLING
+static void rebindVaoToVbo([[maybe_unused]] u32 vao, [[maybe_unused]] u32 vbo) noexcept {
+    // NOTE: vbo is bound as storage buffer by update()
+}
+#else
 static void rebindVaoToVbo(u32 vao, u32 vbo) noexcept {
     constexpr u32 vertex_attrib_binding = 0U;
 
     glVertexArrayVertexBuffer(vao, vertex_attrib_binding, vbo, 0, sizeof(Vertex));
 }
+#endif
+
+#if defined(USE_VERTEX_PULLING)
+static void setVertexLayout([[maybe_unused]] u32 vao, [[maybe_unused]] u32 vbo, [[maybe_unused]] u32 chunk_origins) noexcept {
+    // NOTE: vertex shader reads quads and chunks' origins from storage buffers,
+    // vao has no attributes
+}
+#elif defined(USE_PACKED_VERTEX)
+static void setVertexLayout(u32 vao, u32 vbo, u32 chunk_origins) noexcept {
+    constexpr u32 vertex_attrib_binding = 0U;
+    constexpr u32 chunk_origin_attrib_binding = 1U;
+
+    glEnableVertexArrayAttrib(vao, VE001_SH_CONFIG_ATTRIB_INDEX_POSITION);
+    glEnableVertexArrayAttrib(vao, VE001_SH_CONFIG_ATTRIB_INDEX_CHUNK_ORIGIN);
 
+    glVertexArrayAttribIFormat(vao, VE001_SH_CONFIG_ATTRIB_INDEX_POSITION, 2, GL_UNSIGNED_INT, offsetof(Vertex, data));
+    glVertexArrayAttribFormat(vao, VE001_SH_CONFIG_ATTRIB_INDEX_CHUNK_ORIGIN, 3, GL_FLOAT, GL_FALSE, 0);
+
+    glVertexArrayAttribBinding(vao, VE001_SH_CONFIG_ATTRIB_INDEX_POSITION, vertex_attrib_binding);
+    glVertexArrayAttribBinding(vao, VE001_SH_CONFIG_ATTRIB_INDEX_CHUNK_ORIGIN, chunk_origin_attrib_binding);
+
+    // NOTE: each draw command draws a single instance, base_instance selects the origin
+    glVertexArrayBindingDivisor(vao, vertex_attrib_binding, 0);
+    glVertexArrayBindingDivisor(vao, chunk_origin_attrib_binding, 1);
+
+    glVertexArrayVertexBuffer(vao, vertex_attrib_binding, vbo, 0, sizeof(Vertex));
+    glVertexArrayVertexBuffer(vao, chunk_origin_attrib_binding, chunk_origins, 0, sizeof(Vec3f32));
+}
+#else
 static void setVertexLayout(u32 vao, u32 vbo) noexcept {
     constexpr u32 vertex_attrib_binding = 0U;
 
@@ -30,18 +66,31 @@ static void setVertexLayout(u32 vao, u32 vbo) noexcept {
 
     glVertexArrayVertexBuffer(vao, vertex_attrib_binding, vbo, 0, sizeof(Vertex));
 }
+#endif
+
+/// @brief points the command to the submesh which starts at <quads_offset> quad of vbo
+static void setQuadsOffset(ChunkPool::DrawElementsIndirectCmd& draw_cmd, u64 quads_offset) noexcept {
+#ifdef USE_VERTEX_PULLING
+    draw_cmd.first = static_cast<u32>(quads_offset * 6UL);
+#else
+    draw_cmd.base_vertex = static_cast<i32>(quads_offset * 4UL);
+#endif
+}
 
 void ChunkPool::init() noexcept {
-    u32 tmp[3] = { 0U, 0U, 0U };
+    // NOTE: ibo is created with the limits (there is none if quads
+    // are expanded by the vertex shader)
+    constexpr i32 buffers_count{ 2 };
+    u32 tmp[2] = { 0U, 0U };
 
-    glCreateBuffers(3, tmp);
+    glCreateBuffers(buffers_count, tmp);
     _vbo_id = tmp[0];
-    _ibo_id = tmp[1];
-    _dibo_id = tmp[2];
+    _dibo_id = tmp[1];
 
+    _vbo_size = static_cast<u64>(_chunks_count) * _engine_context.chunk_max_current_mesh_size;
     glNamedBufferStorage(
         _vbo_id, 
-        static_cast<i64>(_chunks_count) * static_cast<i64>(_engine_context.chunk_max_current_mesh_size), 
+        static_cast<i64>(_vbo_size), 
         nullptr, 
         0
     );
@@ -51,12 +100,30 @@ void ChunkPool::init() noexcept {
         return;
     }
 
+#if defined(USE_PACKED_VERTEX) || defined(USE_VERTEX_PULLING)
+    glCreateBuffers(1, &_chunk_origins_id);
+    glNamedBufferStorage(
+        _chunk_origins_id, 
+        static_cast<i64>(static_cast<u64>(_chunks_count) * sizeof(Vec3f32)), 
+        nullptr, 
+        GL_DYNAMIC_STORAGE_BIT
+    );
+
+    if (glGetError() == GL_OUT_OF_MEMORY) {
+        _engine_context.error |= Error::GPU_ALLOCATION_FAILED;
+        return;
+    }
+
+    glCreateVertexArrays(1, &_vao_id);
+    setVertexLayout(_vao_id, _vbo_id, _chunk_origins_id);
+#else
     glCreateVertexArrays(1, &_vao_id);
     setVertexLayout(_vao_id, _vbo_id);
+#endif
 
     glNamedBufferStorage(
         _dibo_id,
-        6 * _chunks_count * sizeof(DrawElementsIndirectCmd),
+        DIBO_REGIONS_COUNT * 6 * _chunks_count * sizeof(DrawElementsIndirectCmd),
         nullptr,
         GL_MAP_WRITE_BIT|GL_MAP_PERSISTENT_BIT|GL_MAP_COHERENT_BIT
     );
@@ -68,12 +135,12 @@ void ChunkPool::init() noexcept {
 
     _dibo_mapped_ptr = glMapNamedBufferRange(
         _dibo_id, 
-        0, 6 * _chunks_count * sizeof(DrawElementsIndirectCmd),
+        0, DIBO_REGIONS_COUNT * 6 * _chunks_count * sizeof(DrawElementsIndirectCmd),
         GL_MAP_WRITE_BIT|GL_MAP_PERSISTENT_BIT|GL_MAP_COHERENT_BIT
     );
 
     if (_dibo_mapped_ptr == nullptr) {
-        glDeleteBuffers(3, tmp);
+        glDeleteBuffers(buffers_count, tmp);
         glDeleteVertexArrays(1, &_vao_id);
         _engine_context.error |= Error::GPU_BUFFER_MAPPING_FAILED;
         return;
@@ -85,6 +152,9 @@ void ChunkPool::init() noexcept {
         _voxel_data.resize(static_cast<u64>(_chunks_count) * _engine_context.chunk_size_1D);
         _free_chunks = RingBuffer<FreeChunk>(_chunks_count, {});
         _draw_cmds.reserve(_chunks_count * 6);
+        _draw_cmds_block_versions.resize((_chunks_count * 6UL + DRAW_CMDS_PER_BLOCK - 1UL) / DRAW_CMDS_PER_BLOCK, 0UL);
+        _vbo_allocator.init(static_cast<u32>(_vbo_size/VBO_ALLOCATION_UNIT_SIZE), _chunks_count);
+        _quads_history.reserve(QUADS_HISTORY_SIZE);
         for (std::size_t i{ 0U }; i < _chunks_count; ++i) {
             _free_chunks.write({
                 .chunk_id = static_cast<u32>(i),
@@ -92,29 +162,19 @@ void ChunkPool::init() noexcept {
             });
         }
 
-        static constexpr u32 INDICES_PATTERN[6] = { 0U, 1U, 2U, 0U, 2U, 3U };
-        std::vector<u32> indices(_engine_context.chunk_max_possible_submesh_indices_size/sizeof(u32));
-        for (std::size_t i{ 0UL }, q{ 0UL }; i < indices.size(); i += 6UL, q += 4UL) {
-            indices[i + 0] = INDICES_PATTERN[0] + static_cast<u32>(q);
-            indices[i + 1] = INDICES_PATTERN[1] + static_cast<u32>(q);
-            indices[i + 2] = INDICES_PATTERN[2] + static_cast<u32>(q);
-            indices[i + 3] = INDICES_PATTERN[3] + static_cast<u32>(q);
-            indices[i + 4] = INDICES_PATTERN[4] + static_cast<u32>(q);
-            indices[i + 5] = INDICES_PATTERN[5] + static_cast<u32>(q);
-        }
-        glNamedBufferStorage(_ibo_id, static_cast<i64>(_engine_context.chunk_max_possible_submesh_indices_size), static_cast<const void*>(indices.data()), 0);
-
-		if (glGetError() == GL_OUT_OF_MEMORY) {
-			_engine_context.error |= Error::GPU_ALLOCATION_FAILED;
-			return;
-    	}
     } catch ([[maybe_unsused]] const std::exception& e) {
-        glDeleteBuffers(3, tmp);
+        glDeleteBuffers(buffers_count, tmp);
         glDeleteVertexArrays(1, &_vao_id);
         _engine_context.error |= Error::CPU_ALLOCATION_FAILED;
         return;
     }
 
+#ifndef USE_VERTEX_PULLING
+    if (!growIbo(maxCurrentSubmeshQuads())) {
+        return;
+    }
+#endif
+
     _meshing_engine->init(_vbo_id);
 }
 
@@ -136,12 +196,24 @@ vmath::u32 ChunkPool::allocateChunk(std::span<const vmath::u16> src, Vec3i32 pos
         Vec3f32::cast(Vec3i32::sub(Vec3i32::mul(position, _engine_context.chunk_size), _engine_context.half_chunk_size)), 
         {0U, 0U, 0U, 0U, 0U, 0U}, // bcs chunk isn't complete yet
         free_chunk.cpu_region,
+        {},
         free_chunk.chunk_id,
         false
     });
 
     _chunk_id_to_index[chunk.chunk_id] = _chunks.size() - 1;
 
+#if defined(USE_PACKED_VERTEX) || defined(USE_VERTEX_PULLING)
+    // NOTE: buffer update is ordered after draws which may still use the origin
+    // of the previous chunk with the same id
+    glNamedBufferSubData(
+        _chunk_origins_id, 
+        static_cast<GLintptr>(static_cast<u64>(chunk.chunk_id) * sizeof(Vec3f32)), 
+        sizeof(Vec3f32), 
+        static_cast<const void*>(&chunk.position)
+    );
+#endif
+
     _meshing_engine->issueMeshingCommand(chunk.chunk_id, chunk.position, chunk.cpu_region);
 
 #ifdef ENGINE_TEST
@@ -152,18 +224,43 @@ vmath::u32 ChunkPool::allocateChunk(std::span<const vmath::u16> src, Vec3i32 pos
 }
 
 void ChunkPool::completeChunk(MeshingEngineBase::Result result) noexcept {
+    // NOTE: overflow is handled even if the chunk was already deallocated,
+    // meshing engine waits for new limits
+    if (result.overflow_flag) {
+        recreatePool(result);
+        return;
+    }
+
+    // NOTE: limits grow so that next chunks of similar size don't have to spill
+    if (result.spilled) {
+        updateLimits(result);
+    }
+
     const auto chunk_index = _chunk_id_to_index[result.chunk_id];
     if (chunk_index == INVALID_CHUNK_INDEX) {
         return;
     }
 
-    if (result.overflow_flag) {
-        recreatePool(result);
-        return;
+    u32 quads_count{ 0U };
+    for (const auto written_indices : result.written_indices) {
+        quads_count += written_indices/6U;
+    }
+
+    auto mesh_allocation = _vbo_allocator.allocate(quads_count);
+    if (quads_count > 0U && mesh_allocation.block == TLSFAllocator::INVALID_BLOCK) {
+        // NOTE: mesh still waits in the meshing engine, it's uploaded after the growth
+        if (!growVbo(quads_count)) {
+            return;
+        }
+        mesh_allocation = _vbo_allocator.allocate(quads_count);
+    }
+    if (mesh_allocation.block != TLSFAllocator::INVALID_BLOCK) {
+        _meshing_engine->uploadMesh(result, static_cast<u64>(mesh_allocation.offset) * VBO_ALLOCATION_UNIT_SIZE);
     }
 
     auto& chunk = _chunks[chunk_index];
     chunk.complete = true;
+    chunk.mesh_allocation = mesh_allocation;
     const auto base_cmd_index = static_cast<u32>(_draw_cmds.size());
     chunk.draw_cmd_indices[X_POS] = base_cmd_index + X_POS;
     chunk.draw_cmd_indices[X_NEG] = base_cmd_index + X_NEG;
@@ -172,85 +269,425 @@ void ChunkPool::completeChunk(MeshingEngineBase::Result result) noexcept {
     chunk.draw_cmd_indices[Z_POS] = base_cmd_index + Z_POS;
     chunk.draw_cmd_indices[Z_NEG] = base_cmd_index + Z_NEG;
 
+    // NOTE: submeshes are packed in ve001::Face order
+    u64 quads_offset{ mesh_allocation.offset };
     for (std::size_t i{ 0U }; i < 6U; ++i) {
-        const auto& draw_cmd = _draw_cmds.emplace_back(DrawElementsIndirectCmd{
+        auto& draw_cmd = _draw_cmds.emplace_back(DrawElementsIndirectCmd{
             .count = result.written_indices[i],
             .instance_count = 1U,
+#ifdef USE_VERTEX_PULLING
+            .first = 0U,
+#else
             .first_index = 0U,
-            .base_vertex =  static_cast<i32>((((static_cast<u64>(result.chunk_id) * 6UL) + i) * _engine_context.chunk_max_current_submesh_size)/sizeof(Vertex)),
-            .base_instance = 0U,
+            .base_vertex = 0,
+#endif
+            // NOTE: selects chunk's origin if packed vertices are used
+            .base_instance = result.chunk_id,
             .orientation = static_cast<Face>(i),
             .chunk_id = result.chunk_id
         });
+        setQuadsOffset(draw_cmd, quads_offset);
+        quads_offset += draw_cmd.count/6;
+        markDrawCmdDirty(base_cmd_index + i);
 #ifdef ENGINE_TEST
-        gpu_memory_usage += static_cast<u64>(draw_cmd.count/6) * sizeof(Vertex) * 4;
+        gpu_memory_usage += static_cast<u64>(draw_cmd.count/6) * VBO_ALLOCATION_UNIT_SIZE;
 #endif
     }
-    _draw_cmds_dirty = true;
+
+    trackQuadsCounts(result);
+}
+
+void ChunkPool::trackQuadsCounts(const MeshingEngineBase::Result& result) noexcept {
+    for (std::size_t face{ 0UL }; face < 6UL; ++face) {
+        auto& quads_histogram = _quads_histograms[face];
+        const auto quads_count = result.written_indices[face]/6U;
+        if (_quads_history.size() < QUADS_HISTORY_SIZE) {
+            _quads_history.push_back(quads_count);
+        } else {
+            --quads_histogram[std::bit_width(_quads_history[_quads_history_writer])];
+            _quads_history[_quads_history_writer] = quads_count;
+        }
+        ++quads_histogram[std::bit_width(quads_count)];
+        _quads_history_writer = (_quads_history_writer + 1U) % QUADS_HISTORY_SIZE;
+    }
+
+    // NOTE: limits are fixed to max possible size without growth coefficient
+    if (_quads_history.size() < QUADS_HISTORY_SIZE || _engine_context.chunk_pool_growth_coefficient == 0.F) {
+        return;
+    }
+
+    bool limits_changed{ false };
+    for (std::size_t face{ 0UL }; face < 6UL; ++face) {
+        // NOTE: high-water mark is the upper bound of the highest non empty bucket
+        const auto& quads_histogram = _quads_histograms[face];
+        u32 high_water_mark{ 0U };
+        for (u32 bucket{ static_cast<u32>(quads_histogram.size()) - 1U }; bucket > 0U; --bucket) {
+            if (quads_histogram[bucket] > 0U) {
+                high_water_mark = static_cast<u32>((1UL << bucket) - 1UL);
+                break;
+            }
+        }
+
+        auto& submesh_size = _engine_context.chunk_max_current_submesh_sizes[face];
+        if (static_cast<u64>(high_water_mark) * SHRINK_RATIO >= submesh_size/VBO_ALLOCATION_UNIT_SIZE) {
+            continue;
+        }
+
+        // NOTE: chunks which won't fit the smaller limits are spilled
+        // (cpu) or overflow and grow the limits back (gpu)
+        const auto new_max_quads = static_cast<u64>(
+            _engine_context.chunk_pool_growth_coefficient * static_cast<f32>(high_water_mark)
+        ) + 1UL;
+        submesh_size = new_max_quads * VBO_ALLOCATION_UNIT_SIZE;
+        limits_changed = true;
+    }
+    if (!limits_changed) {
+        return;
+    }
+
+    _engine_context.chunk_max_current_mesh_size = 0UL;
+    for (const auto submesh_size : _engine_context.chunk_max_current_submesh_sizes) {
+        _engine_context.chunk_max_current_mesh_size += submesh_size;
+    }
+    _meshing_engine->updateMetadata(_vbo_id);
 }
 
 void ChunkPool::update(bool use_partition) noexcept {
+    compactVbo();
+
     if (_draw_cmds.size() > 0U) {
         if (use_partition && _draw_cmds_parition_size == 0U) {
             return;
         }
         if (_draw_cmds_dirty) {
-            const auto size = (use_partition ? _draw_cmds_parition_size : _draw_cmds.size()) * sizeof(DrawElementsIndirectCmd);
-            std::memcpy(_dibo_mapped_ptr, static_cast<const void*>(_draw_cmds.data()), size);
-            _draw_cmds_dirty = false;
+            writeDrawCmds();
             glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _dibo_id);
         }
         glBindVertexArray(_vao_id);
+#ifdef USE_VERTEX_PULLING
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VE001_SH_CONFIG_SSBO_BINDING_QUADS_DATA, _vbo_id);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VE001_SH_CONFIG_SSBO_BINDING_CHUNK_ORIGINS, _chunk_origins_id);
+#else
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ibo_id);
         glBindBuffer(GL_ARRAY_BUFFER, _vbo_id);
+#endif
+    }
+}
+
+void ChunkPool::writeDrawCmds() noexcept {
+    // NOTE: the gpu may still draw from the region in frame which is DIBO_REGIONS_COUNT - 1
+    // frames behind, the wait blocks only if the gpu is that far behind
+    const auto region = (_dibo_region + 1U) % DIBO_REGIONS_COUNT;
+    if (auto& fence = _dibo_fences[region]; fence != nullptr) {
+        auto wait_result = glClientWaitSync(static_cast<GLsync>(fence), GL_SYNC_FLUSH_COMMANDS_BIT, DIBO_FENCE_WAIT_TIMEOUT_NS);
+        while (wait_result == GL_TIMEOUT_EXPIRED) {
+            wait_result = glClientWaitSync(static_cast<GLsync>(fence), 0, DIBO_FENCE_WAIT_TIMEOUT_NS);
+        }
+        if (wait_result == GL_WAIT_FAILED) {
+            _engine_context.error |= Error::FENCE_WAIT_FAILED;
+        }
+        glDeleteSync(static_cast<GLsync>(fence));
+        fence = nullptr;
     }
+
+    // NOTE: region keeps all commands (not only the partition), so that blocks outside
+    // of the partition are up to date once it grows. Adjacent changed blocks are
+    // written by a single copy
+    auto* region_ptr = static_cast<DrawElementsIndirectCmd*>(_dibo_mapped_ptr) + static_cast<std::size_t>(region) * _chunks_count * 6UL;
+    const auto region_version = _dibo_region_versions[region];
+    const auto blocks_count = (_draw_cmds.size() + DRAW_CMDS_PER_BLOCK - 1UL) / DRAW_CMDS_PER_BLOCK;
+    std::size_t block{ 0UL };
+    while (block < blocks_count) {
+        if (_draw_cmds_block_versions[block] <= region_version) {
+            ++block;
+            continue;
+        }
+        const auto first_block = block;
+        while (block < blocks_count && _draw_cmds_block_versions[block] > region_version) {
+            ++block;
+        }
+        const auto begin = first_block * DRAW_CMDS_PER_BLOCK;
+        const auto end = std::min(block * DRAW_CMDS_PER_BLOCK, _draw_cmds.size());
+        std::memcpy(static_cast<void*>(region_ptr + begin), static_cast<const void*>(_draw_cmds.data() + begin),
+            (end - begin) * sizeof(DrawElementsIndirectCmd));
+    }
+
+    _dibo_region_versions[region] = _draw_cmds_version;
+    ++_draw_cmds_version;
+    _dibo_region = region;
+    _draw_cmds_dirty = false;
 }
 
 void ChunkPool::recreatePool(MeshingEngineBase::Result overflow_result) noexcept {
-    const auto max_written_indices_x_axis = std::max(overflow_result.written_indices[X_POS], overflow_result.written_indices[X_NEG]);
-    const auto max_written_indices_y_axis = std::max(overflow_result.written_indices[Y_POS], overflow_result.written_indices[Y_NEG]);
-    const auto max_written_indices_z_axis = std::max(overflow_result.written_indices[Z_POS], overflow_result.written_indices[Z_NEG]);
-    const auto max_written_indices = std::max(std::max(max_written_indices_x_axis, max_written_indices_y_axis), max_written_indices_z_axis);
+    updateLimits(overflow_result);
+
+    // NOTE: overflowed chunk was deallocated (its meshing was cancelled)
+    if (overflow_result.chunk_id == INVALID_CHUNK_ID) {
+        return;
+    }
+    const auto chunk_index = _chunk_id_to_index[overflow_result.chunk_id];
+    if (chunk_index == INVALID_CHUNK_INDEX) {
+        return;
+    }
+    auto& chunk = _chunks[chunk_index];
+    _meshing_engine->issueMeshingCommand(chunk.chunk_id, chunk.position, chunk.cpu_region);
+}
 
-    auto new_max_vertices_in_submesh = static_cast<u64>(
-        ((_engine_context.chunk_pool_growth_coefficient * static_cast<f32>(max_written_indices)) / 6.F) * 4.F
+void ChunkPool::updateLimits(MeshingEngineBase::Result overflow_result) noexcept {
+    // NOTE: only faces which overflowed grow, eg. top/bottom faces of terrain
+    // are usually much bigger than the side ones
+    bool limits_changed{ false };
+    for (std::size_t face{ 0UL }; face < 6UL; ++face) {
+        auto new_max_vertices_in_submesh = static_cast<u64>(
+            ((_engine_context.chunk_pool_growth_coefficient * static_cast<f32>(overflow_result.written_indices[face])) / 6.F) * static_cast<f32>(VERTICES_PER_QUAD)
+        );
+        new_max_vertices_in_submesh = new_max_vertices_in_submesh + (VERTICES_PER_QUAD - new_max_vertices_in_submesh % VERTICES_PER_QUAD);
+
+        const auto new_submesh_size = std::min(
+            new_max_vertices_in_submesh * sizeof(Vertex), 
+            _engine_context.chunk_max_possible_submesh_size
+        );
+        // NOTE: spilled result may come from a job which read older (smaller) limits
+        if (new_submesh_size <= _engine_context.chunk_max_current_submesh_sizes[face]) {
+            continue;
+        }
+        _engine_context.chunk_max_current_submesh_sizes[face] = new_submesh_size;
+        limits_changed = true;
+    }
+    if (!limits_changed) {
+        return;
+    }
+
+    _engine_context.chunk_max_current_mesh_size = 0UL;
+    for (const auto submesh_size : _engine_context.chunk_max_current_submesh_sizes) {
+        _engine_context.chunk_max_current_mesh_size += submesh_size;
+    }
+
+#ifndef USE_VERTEX_PULLING
+    // NOTE: on failure the old ibo is kept, error is reported by growIbo
+    growIbo(maxCurrentSubmeshQuads());
+#endif
+
+    // NOTE: only meshing limits grow, complete chunks are packed in vbo
+    // independently of submesh size so they are kept
+    _meshing_engine->updateMetadata(_vbo_id);
+}
+
+u64 ChunkPool::projectedVboCapacity(u64 meshes_size, u64 meshes_count) const noexcept {
+    const auto growth_coefficient = static_cast<f64>(std::max(_engine_context.chunk_pool_growth_coefficient, 1.F));
+    return static_cast<u64>(
+        static_cast<f64>(meshes_size) / static_cast<f64>(meshes_count) * static_cast<f64>(_chunks_count) * growth_coefficient
     );
-    new_max_vertices_in_submesh = new_max_vertices_in_submesh + (4 - new_max_vertices_in_submesh % 4);
+}
 
-    _engine_context.chunk_max_current_submesh_size = new_max_vertices_in_submesh * sizeof(Vertex);
-    if (_engine_context.chunk_max_current_submesh_size > _engine_context.chunk_max_possible_submesh_size) {
-        _engine_context.chunk_max_current_submesh_size = _engine_context.chunk_max_possible_submesh_size;
+bool ChunkPool::growVbo(u32 quads_count) noexcept {
+    // NOTE: new size is projected from average mesh size of complete chunks
+    // so that vbo doesn't have to grow again with each few chunks
+    u64 complete_chunks_count{ 1UL };
+    for (const auto& chunk : _chunks) {
+        complete_chunks_count += chunk.complete ? 1UL : 0UL;
+    }
+    const auto capacity = static_cast<u64>(_vbo_allocator.capacity());
+    const auto growth_coefficient = static_cast<f64>(std::max(_engine_context.chunk_pool_growth_coefficient, 1.F));
+    const auto projected_capacity = projectedVboCapacity(
+        static_cast<u64>(_vbo_allocator.used()) + quads_count, complete_chunks_count
+    );
+    const auto max_capacity = std::max(
+        static_cast<u64>(_chunks_count) * _engine_context.chunk_max_possible_mesh_size / VBO_ALLOCATION_UNIT_SIZE,
+        capacity + quads_count
+    );
+    auto new_capacity = std::max({
+        static_cast<u64>(static_cast<f64>(capacity) * growth_coefficient),
+        projected_capacity,
+        // NOTE: appended range is merged with free range at the end so the mesh always fits
+        capacity + quads_count
+    });
+    new_capacity = std::min({ new_capacity, max_capacity, static_cast<u64>(std::numeric_limits<u32>::max()) });
+    if (new_capacity <= capacity) {
+        _engine_context.error |= Error::GPU_ALLOCATION_FAILED;
+        return false;
     }
-    _engine_context.chunk_max_current_mesh_size = _engine_context.chunk_max_current_submesh_size * 6U;
-	
-    glDeleteBuffers(1, &_vbo_id);
-    glCreateBuffers(1, &_vbo_id);
 
-    glNamedBufferStorage(_vbo_id, static_cast<u64>(_chunks_count) * _engine_context.chunk_max_current_mesh_size, nullptr, 0);
+    u32 new_vbo_id{ 0U };
+    glCreateBuffers(1, &new_vbo_id);
+
+    const auto new_vbo_size = new_capacity * VBO_ALLOCATION_UNIT_SIZE;
+    glNamedBufferStorage(new_vbo_id, static_cast<i64>(new_vbo_size), nullptr, 0);
 
 	if (glGetError() == GL_OUT_OF_MEMORY) {
+        // NOTE: old vbo is kept, chunks are still drawn
+        glDeleteBuffers(1, &new_vbo_id);
 		_engine_context.error |= Error::GPU_ALLOCATION_FAILED;
-		return;
+		return false;
 	}
 
+    // NOTE: meshes are moved on the gpu side and keep their offsets, so complete
+    // chunks aren't meshed again and their draw commands stay valid. Draws
+    // already issued from the old vbo are finished before it's released.
+    // Deferred uploads of the current poll have to land in the old vbo first
+    _meshing_engine->flushUploads();
+    glCopyNamedBufferSubData(_vbo_id, new_vbo_id, 0, 0, static_cast<GLintptr>(_vbo_size));
+    glDeleteBuffers(1, &_vbo_id);
+    _vbo_id = new_vbo_id;
+    _vbo_size = new_vbo_size;
+
     rebindVaoToVbo(_vao_id, _vbo_id);
 
-    _meshing_engine->updateMetadata(_vbo_id);
+    _meshing_engine->updateVbo(_vbo_id);
+    _vbo_allocator.grow(static_cast<u32>(new_capacity));
+    _vbo_compaction_target = 0U;
 
+    return true;
+}
+
+#ifndef USE_VERTEX_PULLING
+bool ChunkPool::growIbo(u64 quads_count) noexcept {
+    if (quads_count <= _ibo_quads_capacity) {
+        return true;
+    }
+    // NOTE: ibo grows by the same coefficient as vbo so that it isn't
+    // recreated with each small growth of the limits
+    const auto growth_coefficient = static_cast<f64>(std::max(_engine_context.chunk_pool_growth_coefficient, 1.F));
+    const auto max_capacity = _engine_context.chunk_max_possible_submesh_indices_size / (6UL * sizeof(u32));
+    const auto new_capacity = std::min(
+        std::max(static_cast<u64>(static_cast<f64>(_ibo_quads_capacity) * growth_coefficient), quads_count),
+        std::max(max_capacity, quads_count)
+    );
+
+    static constexpr u32 INDICES_PATTERN[6] = { 0U, 1U, 2U, 0U, 2U, 3U };
+    std::vector<u32> indices;
+    try {
+        indices.resize(new_capacity * 6UL);
+    } catch ([[maybe_unused]] const std::exception& e) {
+        _engine_context.error |= Error::CPU_ALLOCATION_FAILED;
+        return false;
+    }
+    for (std::size_t i{ 0UL }, q{ 0UL }; i < indices.size(); i += 6UL, q += 4UL) {
+        indices[i + 0] = INDICES_PATTERN[0] + static_cast<u32>(q);
+        indices[i + 1] = INDICES_PATTERN[1] + static_cast<u32>(q);
+        indices[i + 2] = INDICES_PATTERN[2] + static_cast<u32>(q);
+        indices[i + 3] = INDICES_PATTERN[3] + static_cast<u32>(q);
+        indices[i + 4] = INDICES_PATTERN[4] + static_cast<u32>(q);
+        indices[i + 5] = INDICES_PATTERN[5] + static_cast<u32>(q);
+    }
+
+    u32 new_ibo_id{ 0U };
+    glCreateBuffers(1, &new_ibo_id);
+    glNamedBufferStorage(new_ibo_id, static_cast<i64>(indices.size() * sizeof(u32)), static_cast<const void*>(indices.data()), 0);
+
+    if (glGetError() == GL_OUT_OF_MEMORY) {
+        glDeleteBuffers(1, &new_ibo_id);
+        _engine_context.error |= Error::GPU_ALLOCATION_FAILED;
+        return false;
+    }
+
+    // NOTE: draws already issued with the old ibo are finished before it's released,
+    // new one is bound with the next update
+    glDeleteBuffers(1, &_ibo_id);
+    _ibo_id = new_ibo_id;
+    _ibo_quads_capacity = new_capacity;
+
+    return true;
+}
+
+u64 ChunkPool::maxCurrentSubmeshQuads() const noexcept {
+    const auto& submesh_sizes = _engine_context.chunk_max_current_submesh_sizes;
+    return *std::max_element(submesh_sizes.begin(), submesh_sizes.end()) / VBO_ALLOCATION_UNIT_SIZE;
+}
+#endif
+
+void ChunkPool::compactVbo() noexcept {
+    if (_vbo_compaction_target == 0U) {
+        if (_vbo_compaction_retry_delay > 0U) {
+            --_vbo_compaction_retry_delay;
+            return;
+        }
+        // NOTE: decision is based on the same window as limits, so the pool
+        // isn't shrunk while it's being filled
+        if (_quads_history.size() < QUADS_HISTORY_SIZE) {
+            return;
+        }
+        u64 complete_chunks_count{ 0UL };
+        for (const auto& chunk : _chunks) {
+            complete_chunks_count += chunk.complete ? 1UL : 0UL;
+        }
+        if (complete_chunks_count == 0UL) {
+            return;
+        }
+        const auto used = static_cast<u64>(_vbo_allocator.used());
+        const auto target = std::max(projectedVboCapacity(used, complete_chunks_count), used);
+        if (target == 0UL || target * SHRINK_RATIO >= _vbo_allocator.capacity()) {
+            return;
+        }
+        _vbo_compaction_target = static_cast<u32>(target);
+    }
+
+    u32 moves_count{ 0U };
     for (auto& chunk : _chunks) {
-        if (chunk.complete) {
-            deallocateChunkDrawCommands(chunk.chunk_id);
-            chunk.complete = false;
-            _meshing_engine->issueMeshingCommand(chunk.chunk_id, chunk.position, chunk.cpu_region);
+        const auto mesh_allocation = chunk.mesh_allocation;
+        if (mesh_allocation.block == TLSFAllocator::INVALID_BLOCK) {
+            continue;
+        }
+        const auto size = _vbo_allocator.size(mesh_allocation);
+        if (mesh_allocation.offset + size <= _vbo_compaction_target) {
+            continue;
+        }
+        if (moves_count == COMPACTION_MOVES_PER_UPDATE) {
+            return;
+        }
+
+        const auto new_mesh_allocation = _vbo_allocator.allocateBelow(size, _vbo_compaction_target);
+        if (new_mesh_allocation.block == TLSFAllocator::INVALID_BLOCK) {
+            // NOTE: free space below the target is fragmented (or it was taken by new meshes)
+            _vbo_compaction_target = 0U;
+            _vbo_compaction_retry_delay = COMPACTION_RETRY_DELAY;
+            return;
+        }
+
+        // NOTE: ranges don't overlap, draws issued before the copy still read the old range
+        glCopyNamedBufferSubData(_vbo_id, _vbo_id, 
+            static_cast<GLintptr>(static_cast<u64>(mesh_allocation.offset) * VBO_ALLOCATION_UNIT_SIZE),
+            static_cast<GLintptr>(static_cast<u64>(new_mesh_allocation.offset) * VBO_ALLOCATION_UNIT_SIZE),
+            static_cast<GLintptr>(static_cast<u64>(size) * VBO_ALLOCATION_UNIT_SIZE)
+        );
+        u64 quads_offset{ new_mesh_allocation.offset };
+        for (const auto draw_cmd_index : chunk.draw_cmd_indices) {
+            auto& draw_cmd = _draw_cmds[draw_cmd_index];
+            setQuadsOffset(draw_cmd, quads_offset);
+            quads_offset += draw_cmd.count/6;
+            markDrawCmdDirty(draw_cmd_index);
         }
+
+        _vbo_allocator.free(mesh_allocation);
+        chunk.mesh_allocation = new_mesh_allocation;
+        ++moves_count;
     }
 
-    const auto chunk_index = _chunk_id_to_index[overflow_result.chunk_id];
-    if (chunk_index == INVALID_CHUNK_INDEX) {
+    // NOTE: fails if end of vbo was taken by a new mesh, it's moved by next step
+    if (!_vbo_allocator.shrink(_vbo_compaction_target)) {
         return;
     }
-    auto& chunk = _chunks[chunk_index];
-    _meshing_engine->issueMeshingCommand(chunk.chunk_id, chunk.position, chunk.cpu_region);
+
+    const auto new_vbo_size = static_cast<u64>(_vbo_compaction_target) * VBO_ALLOCATION_UNIT_SIZE;
+    _vbo_compaction_target = 0U;
+
+    u32 new_vbo_id{ 0U };
+    glCreateBuffers(1, &new_vbo_id);
+    glNamedBufferStorage(new_vbo_id, static_cast<i64>(new_vbo_size), nullptr, 0);
+
+	if (glGetError() == GL_OUT_OF_MEMORY) {
+        // NOTE: old vbo is bigger than the allocator's range, it's still valid
+        glDeleteBuffers(1, &new_vbo_id);
+		return;
+	}
+
+    glCopyNamedBufferSubData(_vbo_id, new_vbo_id, 0, 0, static_cast<GLintptr>(new_vbo_size));
+    glDeleteBuffers(1, &_vbo_id);
+    _vbo_id = new_vbo_id;
+    _vbo_size = new_vbo_size;
+
+    rebindVaoToVbo(_vao_id, _vbo_id);
+    _meshing_engine->updateVbo(_vbo_id);
 }
 
 void ChunkPool::drawAll(bool use_partition) noexcept {
@@ -258,21 +695,54 @@ void ChunkPool::drawAll(bool use_partition) noexcept {
         if (use_partition && _draw_cmds_parition_size == 0U) {
             return;
         }
+        const auto* region_offset = reinterpret_cast<const void*>(
+            static_cast<std::uintptr_t>(_dibo_region) * _chunks_count * 6UL * sizeof(DrawElementsIndirectCmd));
+#ifdef USE_VERTEX_PULLING
+        glMultiDrawArraysIndirect(
+            GL_TRIANGLES,
+            region_offset,
+            use_partition ? _draw_cmds_parition_size : _draw_cmds.size(),
+            sizeof(DrawElementsIndirectCmd)
+        );
+#else
         glMultiDrawElementsIndirect(
             GL_TRIANGLES,
             GL_UNSIGNED_INT,
-            nullptr,
+            region_offset,
             use_partition ? _draw_cmds_parition_size : _draw_cmds.size(),
             sizeof(DrawElementsIndirectCmd)
         );
+#endif
+        // NOTE: region isn't written until the gpu finishes the draw
+        auto& fence = _dibo_fences[_dibo_region];
+        if (fence != nullptr) {
+            glDeleteSync(static_cast<GLsync>(fence));
+        }
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
     }
 }
-bool ChunkPool::poll() noexcept {
-    if (MeshingEngineBase::Result result{}; _meshing_engine->pollMeshingCommand(result)) {
+u32 ChunkPool::poll(u32 max_chunks_count, u64 time_budget_ns) noexcept {
+    const auto begin = std::chrono::steady_clock::now();
+    const auto time_budget = std::chrono::nanoseconds(time_budget_ns);
+
+    u32 count{ 0U };
+    while (max_chunks_count == 0U || count < max_chunks_count) {
+        MeshingEngineBase::Result result{};
+        if (!_meshing_engine->pollMeshingCommand(result)) {
+            break;
+        }
         completeChunk(result);
-        return true;
+        ++count;
+        if (time_budget_ns != 0UL && std::chrono::steady_clock::now() - begin >= time_budget) {
+            break;
+        }
     }
-    return false;
+    // NOTE: meshes completed by the call are uploaded as a single batch
+    _meshing_engine->flushUploads();
+
+    completed_chunks_count += count;
+    last_poll_completed_chunks_count = count;
+    return count;
 }
 
 void ChunkPool::deallocateChunk(u32 chunk_id) noexcept {
@@ -286,6 +756,8 @@ void ChunkPool::deallocateChunk(u32 chunk_id) noexcept {
     }
     const auto chunk = _chunks[chunk_index];
 
+    // NOTE: chunk may still be meshed, its result isn't needed anymore
+    _meshing_engine->cancelMeshingCommand(chunk_id);
 
     if (chunk.complete) {
         deallocateChunkDrawCommands(chunk_id);
@@ -312,11 +784,13 @@ void ChunkPool::deallocateChunk(u32 chunk_id) noexcept {
 #endif
 }
 void ChunkPool::deallocateChunkDrawCommands(ChunkId chunk_id) noexcept {
-    const auto& chunk = _chunks[_chunk_id_to_index[chunk_id]];
+    auto& chunk = _chunks[_chunk_id_to_index[chunk_id]];
+    _vbo_allocator.free(chunk.mesh_allocation);
+    chunk.mesh_allocation = {};
     for (u32 i{ 0U }; i < 6; ++i) {
         const auto draw_cmd_index = chunk.draw_cmd_indices[i];
 #ifdef ENGINE_TEST
-        gpu_memory_usage -= static_cast<u64>(_draw_cmds[draw_cmd_index].count/6) * sizeof(Vertex) * 4;
+        gpu_memory_usage -= static_cast<u64>(_draw_cmds[draw_cmd_index].count/6) * VBO_ALLOCATION_UNIT_SIZE;
 #endif
         if (draw_cmd_index != _draw_cmds.size() - 1U) {
             auto& last_draw_cmd = _draw_cmds.back();
@@ -327,10 +801,10 @@ void ChunkPool::deallocateChunkDrawCommands(ChunkId chunk_id) noexcept {
             last_draw_cmd_chunk.draw_cmd_indices[last_draw_cmd_submesh_index] = draw_cmd_index;
 
             _draw_cmds[draw_cmd_index] = last_draw_cmd;
+            markDrawCmdDirty(draw_cmd_index);
         }
         _draw_cmds.pop_back();
     }
-    _draw_cmds_dirty = true;
 }
 
 void ChunkPool::deinit() noexcept {
@@ -342,14 +816,30 @@ void ChunkPool::deinit() noexcept {
 
     glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
 
+    for (auto& fence : _dibo_fences) {
+        if (fence != nullptr) {
+            glDeleteSync(static_cast<GLsync>(fence));
+            fence = nullptr;
+        }
+    }
     glUnmapNamedBuffer(_dibo_id);
     _dibo_mapped_ptr = nullptr;
 
+#ifdef USE_VERTEX_PULLING
+    u32 tmp[2] = { _vbo_id, _dibo_id };
+    glDeleteBuffers(2, tmp);
+#else
     u32 tmp[3] = { _vbo_id, _dibo_id, _ibo_id };
     glDeleteBuffers(3, tmp);
+    _ibo_id = 0U;
+    _ibo_quads_capacity = 0UL;
+#endif
+#if defined(USE_PACKED_VERTEX) || defined(USE_VERTEX_PULLING)
+    glDeleteBuffers(1, &_chunk_origins_id);
+    _chunk_origins_id = 0U;
+#endif
     _vbo_id = 0U;
     _dibo_id = 0U;
-    _ibo_id = 0U;
 
     _free_chunks.clear();
     _draw_cmds.clear();
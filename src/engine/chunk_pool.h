@@ -1,6 +1,8 @@
 #ifndef VE001_CHUNK_POOL_H
 #define VE001_CHUNK_POOL_H
 
+#include <algorithm>
+#include <array>
 #include <vector>
 #include <span>
 #include <memory>
@@ -12,6 +14,8 @@
 #include "meshing_engine_cpu.h"
 #include "engine_context.h"
 #include "chunk_id.h"
+#include "tlsf_allocator.h"
+#include "vertex.h"
 
 namespace ve001 {
 
@@ -27,6 +31,19 @@ struct ChunkPool {
     /// @brief structure stores drawing command data
     /// which is then stored in draw command buffer
     struct DrawElementsIndirectCmd {
+#ifdef USE_VERTEX_PULLING
+        /// NOTE: layout of DrawArraysIndirectCommand, there is no ibo and vertex shader
+        /// expands quad records (6 vertices per quad) using gl_VertexID
+
+        /// @brief number of vertices (6 per quad)
+        vmath::u32 count;
+        /// @brief number of instances
+        vmath::u32 instance_count;
+        /// @brief first vertex, quad offset in vbo times 6
+        vmath::u32 first;
+        /// @brief base instance from which to start
+        vmath::u32 base_instance;
+#else
         /// @brief number of indices
         vmath::u32 count;
         /// @brief number of instances
@@ -37,6 +54,7 @@ struct ChunkPool {
         vmath::i32 base_vertex;
         /// @brief base instance from which to start
         vmath::u32 base_instance;
+#endif
 
         /// @brief what is orientation of submesh drawn by this command
         Face orientation;
@@ -61,6 +79,9 @@ struct ChunkPool {
         vmath::u32 draw_cmd_indices[6];
         /// @brief pointer to allocated cpu region for this chunk 
         std::span<vmath::u16> cpu_region;
+        /// @brief range of the chunk's mesh in vbo (in quads), submeshes are packed
+        /// one after another. Invalid if chunk isn't complete or its mesh is empty
+        TLSFAllocator::Allocation mesh_allocation;
         /// @brief unique id of this chunk
         ChunkId chunk_id{ 0U };
         /// @brief indicates if chunk is meshed and actively drawn 
@@ -74,18 +95,40 @@ struct ChunkPool {
     ///     GL HANDLES     ///
     //////////////////////////
 
-    /// @brief id of vbo storing all submeshes in regions
+    /// @brief id of vbo storing meshes of all chunks, ranges are sub-allocated
+    /// by <_vbo_allocator>
     vmath::u32 _vbo_id{ 0U };
-    /// @brief id of ibo storing indices, it's the same for each submesh in each chunk
-    /// it's size is always max_submesh_size
+#ifndef USE_VERTEX_PULLING
+    /// @brief id of ibo storing indices, it's the same for each submesh in each chunk.
+    /// It covers the biggest of current submesh limits and grows with them
     vmath::u32 _ibo_id{ 0U };
-    /// @brief id of vao describing vertex layout in vbo
+    /// @brief number of quads covered by <_ibo_id>
+    vmath::u64 _ibo_quads_capacity{ 0UL };
+#endif
+    /// @brief id of vao describing vertex layout in vbo (empty if vertex pulling is used)
     vmath::u32 _vao_id{ 0U };
+#if defined(USE_PACKED_VERTEX) || defined(USE_VERTEX_PULLING)
+    /// @brief id of buffer with chunks' origins indexed by chunk id, packed vertices
+    /// are local to the chunk and its origin is selected by draw command's base_instance
+    /// (instanced attribute or storage buffer read if vertex pulling is used)
+    vmath::u32 _chunk_origins_id{ 0U };
+#endif
     /// @brief id of dibo which is a handle to command buffer 
     /// which stores draw commands for all submeshes (reflects 
     /// submeshes stored in vbo)
     vmath::u32 _dibo_id{ 0U };
     void* _dibo_mapped_ptr{ nullptr };
+    /// @brief number of regions of dibo, each holds copy of all draw commands. Region is
+    /// written while the gpu still reads the previous ones (drawn in previous frames)
+    static constexpr vmath::u32 DIBO_REGIONS_COUNT{ 3U };
+    /// @brief timeout of a single wait for the fence of dibo's region
+    static constexpr vmath::u64 DIBO_FENCE_WAIT_TIMEOUT_NS{ 1000000UL };
+    /// @brief region from which draw commands are drawn
+    vmath::u32 _dibo_region{ 0U };
+    /// @brief fences of last draws from each region (nullptr if region wasn't drawn)
+    std::array<void*, DIBO_REGIONS_COUNT> _dibo_fences{};
+    /// @brief version of <_draw_cmds> written to each region
+    std::array<vmath::u64, DIBO_REGIONS_COUNT> _dibo_region_versions{};
 
     ///////////////////////////
 
@@ -97,8 +140,24 @@ struct ChunkPool {
     /// @brief buffer of draw commands which draw submeshes stored in vbo
     std::vector<DrawElementsIndirectCmd> _draw_cmds;
 
+    /// @brief unit of vbo allocations, meshes always consist of whole quads
+    static constexpr vmath::u64 VBO_ALLOCATION_UNIT_SIZE{ sizeof(Vertex) * VERTICES_PER_QUAD };
+    /// @brief allocator of vbo ranges, each chunk gets exactly as much space
+    /// as its mesh needs (in <VBO_ALLOCATION_UNIT_SIZE> units)
+    TLSFAllocator _vbo_allocator;
+    /// @brief size of vbo in bytes
+    vmath::u64 _vbo_size{ 0UL };
+
     std::size_t _draw_cmds_parition_size{ 0UL };
     bool _draw_cmds_dirty{ false };
+    /// @brief number of draw commands per block of dirty range tracking
+    static constexpr std::size_t DRAW_CMDS_PER_BLOCK{ 64UL };
+    /// @brief version of draw commands which isn't written to any region yet, it
+    /// increases with each write of changed commands
+    vmath::u64 _draw_cmds_version{ 1UL };
+    /// @brief version of the last change of each block of <DRAW_CMDS_PER_BLOCK> draw commands,
+    /// blocks newer than the region's version are written to it
+    std::vector<vmath::u64> _draw_cmds_block_versions;
     ///////////////////////////
 
 
@@ -119,6 +178,26 @@ struct ChunkPool {
 
     /// @brief count of all submeshes
     vmath::i32 _submeshes_count{ 0 };
+
+    /// @brief number of last per-face quad counts tracked by <_quads_histograms>, counts
+    /// of each result are written in Face order so the size is a multiple of 6
+    static constexpr vmath::u32 QUADS_HISTORY_SIZE{ 6U * 1024U };
+    /// @brief limits/vbo shrink once they are bigger than SHRINK_RATIO times what is needed
+    static constexpr vmath::u32 SHRINK_RATIO{ 2U };
+    /// @brief max number of meshes moved by a single compaction step (one step per update)
+    static constexpr vmath::u32 COMPACTION_MOVES_PER_UPDATE{ 8U };
+    /// @brief number of updates after which failed compaction is tried again
+    static constexpr vmath::u32 COMPACTION_RETRY_DELAY{ 1024U };
+
+    /// @brief rolling window of per-face quad counts of last meshing results
+    std::vector<vmath::u32> _quads_history;
+    vmath::u32 _quads_history_writer{ 0U };
+    /// @brief histograms of <_quads_history> per face, bucket n counts quads counts of bit width n
+    std::array<std::array<vmath::u32, 33>, 6> _quads_histograms{};
+    /// @brief size (in vbo allocation units) to which vbo is compacted, 0 if compaction
+    /// isn't in progress
+    vmath::u32 _vbo_compaction_target{ 0U };
+    vmath::u32 _vbo_compaction_retry_delay{ 0U };
     
     //////////////////////////////////
 
@@ -147,8 +226,14 @@ struct ChunkPool {
     ///       METADATA (DEBUG/INFO)      ///
     ////////////////////////////////////////
 
+    /// @brief number of chunks completed by all poll calls
+    vmath::u64 completed_chunks_count{ 0UL };
+    /// @brief number of chunks completed by the last poll call
+    vmath::u32 last_poll_completed_chunks_count{ 0U };
+
 #ifdef ENGINE_TEST
-    /// @brief gpu memory usage in bytes (mesh)
+    /// @brief gpu memory usage in bytes (mesh), equal to allocated
+    /// range of vbo since meshes are allocated exactly
     vmath::u64 gpu_memory_usage{ 0UL };
     /// @brief cpu memory usage in bytes (voxel values)
     vmath::u64 cpu_active_memory_usage{ 0UL };
@@ -170,7 +255,8 @@ struct ChunkPool {
 		if (_engine_context.use_gpu_meshing_engine) {
 			_meshing_engine = std::make_unique<MeshingEngineGPU>(_engine_context, _chunks_count);
 		} else {
-			_meshing_engine = std::make_unique<MeshingEngineCPU>(_engine_context, _chunks_count, 2);
+			_meshing_engine = std::make_unique<MeshingEngineCPU>(_engine_context, _chunks_count,
+				static_cast<vmath::u32>(std::max(_engine_context.cpu_mesher_threads_count, 0)));
 		}
 	}
     /// @brief initializes chunk pool
@@ -188,7 +274,7 @@ struct ChunkPool {
     /// @brief deallocates chunk
     /// @param chunk_id chunk's id to deallocate
     void deallocateChunk(ChunkId chunk_id) noexcept;
-    /// @brief deallocates draw commands of the chunk. Called by deallocateChunk only
+    /// @brief deallocates draw commands and vbo range of the chunk. Called by deallocateChunk only
     /// if deallocated chunk is complete
     /// @param chunk_id chunk's id from which to deallocate draw commands
     void deallocateChunkDrawCommands(ChunkId chunk_id) noexcept;
@@ -198,13 +284,53 @@ struct ChunkPool {
     /// @brief draws all chunks
     /// @param use_partition number of draw commands will be based on last paritioning call (paritionDrawCmds) 
     void drawAll(bool use_partition) noexcept;
+    /// @brief marks draw command as changed, its block is written to dibo by the next update
+    /// @param draw_cmd_index index in <_draw_cmds>
+    void markDrawCmdDirty(std::size_t draw_cmd_index) noexcept {
+        _draw_cmds_block_versions[draw_cmd_index / DRAW_CMDS_PER_BLOCK] = _draw_cmds_version;
+        _draw_cmds_dirty = true;
+    }
+    /// @brief moves to the next dibo region (waits until gpu stops reading it) and writes
+    /// blocks of draw commands changed since the region was written last time
+    void writeDrawCmds() noexcept;
     /// @brief recreates chunk pool based on the meshing result which caused overflow
     /// @param overflow_result meshing result which contains info about overflow
     void recreatePool(MeshingEngineBase::Result overflow_result) noexcept;
-
-    /// @brief polls for chunks that are meshed and are ready to be completed (one at a time)
-    /// @return true if chunk was completed false otherwise
-    bool poll() noexcept;
+    /// @brief grows meshing limits (submesh size) based on the result which
+    /// didn't fit them (overflowed or spilled)
+    /// @param overflow_result meshing result which exceeded the limits
+    void updateLimits(MeshingEngineBase::Result overflow_result) noexcept;
+    /// @brief grows vbo if there is no free range for a mesh. Meshes of complete chunks
+    /// are copied into the new vbo at the same offsets
+    /// @param quads_count size of the mesh in quads which couldn't be allocated
+    /// @return true if vbo grew
+    bool growVbo(vmath::u32 quads_count) noexcept;
+#ifndef USE_VERTEX_PULLING
+    /// @brief recreates ibo if it covers less than <quads_count> quads, old ibo is kept
+    /// if the new one can't be allocated
+    /// @return true if ibo covers <quads_count> quads
+    bool growIbo(vmath::u64 quads_count) noexcept;
+    /// @brief biggest of current submesh limits in quads
+    vmath::u64 maxCurrentSubmeshQuads() const noexcept;
+#endif
+    /// @brief capacity of vbo (in allocation units) needed by the whole pool, projected
+    /// from mesh size of <meshes_count> meshes of <meshes_size> total size
+    vmath::u64 projectedVboCapacity(vmath::u64 meshes_size, vmath::u64 meshes_count) const noexcept;
+    /// @brief records per-face quad counts of the result in the rolling histogram and
+    /// shrinks meshing limits if the high-water mark dropped
+    void trackQuadsCounts(const MeshingEngineBase::Result& result) noexcept;
+    /// @brief single step of background compaction. If vbo is oversized, meshes from its
+    /// end are moved (gpu copy) to free ranges at its beginning, a few per step. Once the
+    /// end is free, vbo is recreated with smaller size
+    void compactVbo() noexcept;
+
+    /// @brief polls for chunks that are meshed and completes as many of them as fit the budget.
+    /// Poll stops at the first call to meshing engine which has no result ready
+    /// @param max_chunks_count max number of chunks completed by the call, 0 means no limit
+    /// @param time_budget_ns time after which no more chunks are completed, 0 means no limit.
+    /// It's checked after each completion, so at least one ready chunk is always completed
+    /// @return number of completed chunks
+    vmath::u32 poll(vmath::u32 max_chunks_count, vmath::u64 time_budget_ns) noexcept;
     /// @brief deinitializes chunk pool
     void deinit() noexcept;
 
@@ -234,12 +360,13 @@ struct ChunkPool {
                 draw_cmd_indices[_draw_cmds[end].orientation] = begin;
             
             std::swap(_draw_cmds[end], _draw_cmds[begin]);
+            markDrawCmdDirty(begin);
+            markDrawCmdDirty(end);
 
             --end;
             ++begin;
         }
         _draw_cmds_parition_size = begin;
-        _draw_cmds_dirty = true;
     }
 };
 
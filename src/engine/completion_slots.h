@@ -0,0 +1,134 @@
+#ifndef VE001_COMPLETION_SLOTS_H
+#define VE001_COMPLETION_SLOTS_H
+
+#include <memory>
+#include <atomic>
+#include <limits>
+
+#include <vmath/vmath.h>
+
+#include "mpmc_ringbuffer.h"
+
+namespace ve001 {
+
+/// @brief pre-allocated pool of one-shot results, replacement of std::promise/std::future
+/// pairs which allocate a shared state per request. Producer acquires a slot and hands its
+/// handle to the consumer, worker completes the slot and consumer takes the value out of
+/// it which releases the slot back to the pool. Consumer which loses interest in the
+/// result can cancel the slot, which is a hint for the worker to skip or stop the work.
+/// Completed slots are also pushed to a ready list, so consumer can take results in order
+/// of their completion instead of the order of requests
+template<typename T>
+struct CompletionSlots {
+    /// @brief handle to a slot, index in <_slots>
+    using Handle = vmath::u32;
+    static constexpr Handle INVALID_HANDLE{ std::numeric_limits<vmath::u32>::max() };
+
+    enum State : vmath::u32 {
+        SLOT_STATE_FREE,
+        /// @brief acquired, value isn't written yet
+        SLOT_STATE_PENDING,
+        /// @brief value is written and can be taken
+        SLOT_STATE_READY
+    };
+    struct Slot {
+        std::atomic_uint32_t state{ SLOT_STATE_FREE };
+        /// @brief cancellation token of the request, reset on acquire
+        std::atomic_bool cancelled{ false };
+        T value{};
+    };
+
+    std::unique_ptr<Slot[]> _slots;
+    /// @brief handles of free slots
+    MPMCRingBuffer<Handle> _free_handles;
+    /// @brief handles of completed slots in order of completion
+    MPMCRingBuffer<Handle> _ready_handles;
+
+    CompletionSlots() noexcept = default;
+
+    /// @brief reallocates the pool, previous slots are dropped. Isn't thread safe
+    /// @param capacity max number of slots acquired at once
+    void resize(std::size_t capacity) {
+        _slots = std::make_unique<Slot[]>(capacity);
+        _free_handles.resize(capacity);
+        _ready_handles.resize(capacity);
+        for (std::size_t i{ 0UL }; i < capacity; ++i) {
+            _free_handles.write(static_cast<Handle>(i));
+        }
+    }
+
+    /// @return handle of pending slot, INVALID_HANDLE if all slots are acquired
+    Handle acquire() noexcept {
+        Handle handle{ INVALID_HANDLE };
+        if (!_free_handles.read(handle)) {
+            return INVALID_HANDLE;
+        }
+        _slots[handle].cancelled.store(false, std::memory_order_relaxed);
+        _slots[handle].state.store(SLOT_STATE_PENDING, std::memory_order_relaxed);
+        return handle;
+    }
+
+    /// @brief marks request as cancelled, slot still has to be completed
+    /// by the worker and taken by the consumer
+    void cancel(Handle handle) noexcept {
+        _slots[handle].cancelled.store(true, std::memory_order_relaxed);
+    }
+
+    bool cancelled(Handle handle) const noexcept {
+        return _slots[handle].cancelled.load(std::memory_order_relaxed);
+    }
+
+    /// @brief token which workers check before and during the work
+    const std::atomic_bool& cancellationToken(Handle handle) const noexcept {
+        return _slots[handle].cancelled;
+    }
+
+    /// @brief writes value of pending slot, pushes it to the ready list and wakes up
+    /// threads waiting for it
+    void complete(Handle handle, T&& value) noexcept {
+        auto& slot = _slots[handle];
+        slot.value = std::move(value);
+        slot.state.store(SLOT_STATE_READY, std::memory_order_release);
+        // NOTE: never fails, there are never more completed slots than capacity
+        _ready_handles.write(handle);
+        // NOTE: doesn't enter the kernel if no one waits
+        slot.state.notify_all();
+    }
+
+    /// @brief takes handle of the next completed slot from the ready list (non-blocking),
+    /// each completed slot is returned exactly once
+    /// @return false if no slot was completed since the last call
+    bool pollReady(Handle& handle) noexcept {
+        return _ready_handles.read(handle);
+    }
+
+    /// @brief blocking variant of pollReady, spins for <spin_count> iterations
+    /// and then parks until any slot is completed
+    void waitReady(Handle& handle, vmath::u32 spin_count) noexcept {
+        _ready_handles.poll(handle, spin_count);
+    }
+
+    /// @brief non-blocking check, equivalent of future's wait_for(0)
+    bool ready(Handle handle) const noexcept {
+        return _slots[handle].state.load(std::memory_order_acquire) == SLOT_STATE_READY;
+    }
+
+    /// @brief blocks until the slot is completed
+    void wait(Handle handle) const noexcept {
+        _slots[handle].state.wait(SLOT_STATE_PENDING, std::memory_order_acquire);
+    }
+
+    /// @brief takes value out of ready slot and releases the slot, handle
+    /// mustn't be used afterwards
+    T get(Handle handle) noexcept {
+        auto& slot = _slots[handle];
+        T value = std::move(slot.value);
+        slot.state.store(SLOT_STATE_FREE, std::memory_order_relaxed);
+        _free_handles.write(handle);
+        return value;
+    }
+};
+
+}
+
+#endif
@@ -1,145 +1,412 @@
 #include "cpu_mesher.h"
+#include "task_pool.h"
 
 #include <cstring>
+#include <bit>
+#include <algorithm>
 
 #include <iostream>
 
 using namespace ve001;
 using namespace vmath;
 
+static constexpr Vec3f32 VERTICES[8] = {
+	{0.f, 0.f, 0.f}, // 0
+	{0.f, 0.f, 1.f}, // 1
+	{0.f, 1.f, 0.f}, // 2 
+	{0.f, 1.f, 1.f}, // 3
+	{1.f, 0.f, 0.f}, // 4
+	{1.f, 0.f, 1.f}, // 5
+	{1.f, 1.f, 0.f}, // 6
+	{1.f, 1.f, 1.f}  // 7
+};
+static constexpr Vec2f32 TEX_COORDS[4] = {
+	{0.f, 0.f},
+	{1.f, 0.f},
+	{1.f, 1.f},
+	{0.f, 1.f}
+};
+static constexpr std::size_t QUADS[6][4] = {
+	{ 5, 4, 6, 7 },
+	{ 0, 1, 3, 2 },
+	{ 2, 3, 7, 6 },
+	{ 4, 5, 1, 0 },
+	{ 1, 5, 7, 3 },
+	{ 4, 0, 2, 6 }
+};
+
+#if defined(USE_VERTEX_PULLING)
+/// @brief writes a record of a quad, position is local to the chunk
+/// @param out destination
+/// @param i logical position of the quad (x, y, slice)
+/// @param mesh_region logical extent of the quad (x, y)
+template<typename Descriptor>
+static void writeQuad(Vertex* out, 
+		const Descriptor& desc,
+		[[maybe_unused]] Vec3f32 chunk_position,
+		Vec3i32 i,
+		Vec3i32 mesh_region,
+		u16 voxel_value) noexcept {
+	Vec3i32 region_offset{ 0, 0, 0 };
+	region_offset[desc.logical_indices[2]] = i[2];
+	region_offset[desc.logical_indices[1]] = i[1];
+	region_offset[desc.logical_indices[0]] = i[0];
+
+	*out = packVertex(region_offset, desc.face, voxel_value, Vec2i32{ mesh_region[0], mesh_region[1] });
+}
+#elif defined(USE_PACKED_VERTEX)
+/// @brief writes 4 packed vertices of a quad, positions are local to the chunk
+/// @param out destination (at least 4 vertices)
+/// @param i logical position of the quad (x, y, slice)
+/// @param mesh_region logical extent of the quad (x, y)
+template<typename Descriptor>
+static void writeQuad(Vertex* out, 
+		const Descriptor& desc,
+		[[maybe_unused]] Vec3f32 chunk_position,
+		Vec3i32 i,
+		Vec3i32 mesh_region,
+		u16 voxel_value) noexcept {
+	Vec3i32 region_extent{ 0, 0, 0 };
+	region_extent[desc.logical_indices[2]] = 1;
+	region_extent[desc.logical_indices[1]] = mesh_region[1];
+	region_extent[desc.logical_indices[0]] = mesh_region[0];
+
+	const Vec2i32 squashed_region_extent {
+		mesh_region[desc.squashed_extent_logical_indices[0]],
+		mesh_region[desc.squashed_extent_logical_indices[1]]
+	};
+
+	Vec3i32 region_offset{ 0, 0, 0 };
+	region_offset[desc.logical_indices[2]] = i[2];
+	region_offset[desc.logical_indices[1]] = i[1];
+	region_offset[desc.logical_indices[0]] = i[0];
+
+	for (std::size_t v{ 0UL }; v < 4UL; ++v) {
+		const auto& corner = VERTICES[QUADS[desc.face][v]];
+		const Vec3i32 position {
+			region_offset[0] + region_extent[0] * static_cast<i32>(corner[0]),
+			region_offset[1] + region_extent[1] * static_cast<i32>(corner[1]),
+			region_offset[2] + region_extent[2] * static_cast<i32>(corner[2])
+		};
+		const Vec2i32 texcoord {
+			squashed_region_extent[0] * static_cast<i32>(TEX_COORDS[v][0]),
+			squashed_region_extent[1] * static_cast<i32>(TEX_COORDS[v][1])
+		};
+		out[v] = packVertex(position, desc.face, voxel_value, texcoord);
+	}
+}
+#else
+/// @brief writes 4 vertices of a quad
+/// @param out destination (at least 4 vertices)
+/// @param i logical position of the quad (x, y, slice)
+/// @param mesh_region logical extent of the quad (x, y)
+template<typename Descriptor>
+static void writeQuad(Vertex* out, 
+		const Descriptor& desc,
+		Vec3f32 chunk_position,
+		Vec3i32 i,
+		Vec3i32 mesh_region,
+		u16 voxel_value) noexcept {
+	Vec3f32 region_extent{ 0.f, 0.f, 0.f };
+	region_extent[desc.logical_indices[2]] = 1.f;
+	region_extent[desc.logical_indices[1]] = static_cast<f32>(mesh_region[1]);
+	region_extent[desc.logical_indices[0]] = static_cast<f32>(mesh_region[0]);
+
+	Vec2f32 squashed_region_extent {
+		static_cast<f32>(mesh_region[desc.squashed_extent_logical_indices[0]]),
+		static_cast<f32>(mesh_region[desc.squashed_extent_logical_indices[1]])
+	};
+
+	Vec3f32 region_offset = chunk_position;
+	region_offset[desc.logical_indices[2]] += static_cast<float>(i[2]);
+	region_offset[desc.logical_indices[1]] += static_cast<float>(i[1]);
+	region_offset[desc.logical_indices[0]] += static_cast<float>(i[0]);
+
+	const auto voxel_value_encoded = static_cast<f32>(6 * (voxel_value - 1)) + static_cast<f32>(desc.face);
+	Vertex v[4];
+	v[0].position = Vec3f32::add(Vec3f32::mul(region_extent, VERTICES[QUADS[desc.face][0]]), region_offset);
+	v[0].texcoord[0] = squashed_region_extent[0] * TEX_COORDS[0][0];
+	v[0].texcoord[1] = squashed_region_extent[1] * TEX_COORDS[0][1];
+	v[0].texcoord[2] = voxel_value_encoded;
+
+	v[1].position = Vec3f32::add(Vec3f32::mul(region_extent, VERTICES[QUADS[desc.face][1]]), region_offset);
+	v[1].texcoord[0] = squashed_region_extent[0] * TEX_COORDS[1][0];
+	v[1].texcoord[1] = squashed_region_extent[1] * TEX_COORDS[1][1];
+	v[1].texcoord[2] = voxel_value_encoded;
+
+	v[2].position = Vec3f32::add(Vec3f32::mul(region_extent, VERTICES[QUADS[desc.face][2]]), region_offset);
+	v[2].texcoord[0] = squashed_region_extent[0] * TEX_COORDS[2][0];
+	v[2].texcoord[1] = squashed_region_extent[1] * TEX_COORDS[2][1];
+	v[2].texcoord[2] = voxel_value_encoded;
+
+	v[3].position = Vec3f32::add(Vec3f32::mul(region_extent, VERTICES[QUADS[desc.face][3]]), region_offset);
+	v[3].texcoord[0] = squashed_region_extent[0] * TEX_COORDS[3][0];
+	v[3].texcoord[1] = squashed_region_extent[1] * TEX_COORDS[3][1];
+	v[3].texcoord[2] = voxel_value_encoded;
+
+	memcpy(out, v, sizeof(v));
+}
+#endif
+
 CpuMesher::CpuMesher(const EngineContext& engine_context, vmath::u32 threads_count,
 		std::size_t capacity) noexcept
  : _engine_context(engine_context) {
+	selectFaceKernels();
+	publishLimits();
+
+	if (threads_count == 0U) {
+		threads_count = std::max(static_cast<u32>(_engine_context.task_pool._workers.size()), 1U);
+	}
+	_threads_count = threads_count;
+
 	try {
 		_meshing_tasks.resize(capacity);
+		_results.resize(capacity);
+		_slots = std::vector<Slot>(threads_count * std::max(_engine_context.cpu_mesher_slots_per_thread, 1U));
+		// NOTE: upload buffers are set by the consumer
+		for (auto& slot : _slots) {
+			if (_use_bitmask_kernel)
+				slot.occupancy_masks.resize(3 * OCCUPANCY_MASKS_PER_AXIS, 0UL);
+		}
 	} catch(const std::exception&) {
 		_engine_context.error |= Error::CPU_ALLOCATION_FAILED;
-		return;
-	}
-
-    try {
-		threads_count = 1;
-		_threads.reserve(threads_count);
-		const std::size_t mesh_size = 
-			_engine_context.chunk_max_current_mesh_size/sizeof(Vertex);
-        for (std::size_t i{ 0U }; i < threads_count; ++i) {
-			auto& t = _threads.emplace_back();
-			for (auto& staging_buffer : t.staging_buffers)
-				staging_buffer.resize(mesh_size, {0});
-
-			t.jthread = std::jthread(&CpuMesher::thread, this, i);
-        }
-    } catch(const std::exception&) {
-        _engine_context.error |= Error::CPU_MESHING_ENGINE_THREAD_ALLOCATION_FAILED;
-        _done = true;
-    }
+		_slots.clear();
+		_done = true;
+	}
 }
 
-void CpuMesher::updateLimits() noexcept {
-	while (_ready_counter > 0) {}
-
-	overflowed = false;
+void CpuMesher::schedule() noexcept {
+	for (;;) {
+		std::size_t slot_index{ 0UL };
+		{
+			std::lock_guard lock_guard(_mutex);
+			// NOTE: extra slots only let results wait for upload, at most
+			// <_threads_count> jobs mesh at once
+			if (_done || _jobs_count >= _threads_count) {
+				return;
+			}
+			slot_index = reserveSlot();
+			if (slot_index == _slots.size()) {
+				return;
+			}
+			++_jobs_count;
+		}
+		// NOTE: posted outside of the lock, if task pool has no
+		// workers the job is executed inline
+		postJob(slot_index);
+	}
+}
 
-	cond_overflowed.notify_all();
+std::size_t CpuMesher::reserveSlot() noexcept {
+	std::size_t slot_index{ 0UL };
+	while (slot_index < _slots.size() && _slots[slot_index].in_use.load(std::memory_order_acquire)) {
+		++slot_index;
+	}
+	if (slot_index == _slots.size() || !_meshing_tasks.read(_slots[slot_index].meshing_task)) {
+		return _slots.size();
+	}
+	_slots[slot_index].in_use.store(true, std::memory_order_relaxed);
+	return slot_index;
 }
 
-void CpuMesher::thread(std::size_t thread_index) noexcept {
-	if (_done)
-		return;
+void CpuMesher::postJob(std::size_t slot_index) noexcept {
+	_engine_context.task_pool.post(TASK_LANE_MESHING, TaskPool::Task{
+		.function = [](void* data, std::size_t index) noexcept {
+			static_cast<CpuMesher*>(data)->job(index);
+		},
+		.data = static_cast<void*>(this),
+		.index = slot_index
+	});
+}
 
-	++_ready_counter;
+void CpuMesher::job(std::size_t slot_index) noexcept {
+	auto& slot = _slots[slot_index];
 
-	auto& self = _threads[thread_index];
+	const auto submesh_sizes = loadLimits();
+	std::size_t mesh_size{ 0UL };
+	for (const auto submesh_size : submesh_sizes) {
+		mesh_size += submesh_size;
+	}
 
-	while (!_done) {
-		auto* use_flag = &self.staging_buffer_in_use_flags[self.current_buffer];
-		while (use_flag->load(std::memory_order_acquire)) {
-			self.current_buffer = (self.current_buffer + 1) % self.staging_buffers.size();
-			use_flag = &self.staging_buffer_in_use_flags[self.current_buffer];
+	// NOTE: previous result of the slot was already consumed
+	if (!slot.spill_buffer.empty()) {
+		std::vector<Vertex>().swap(slot.spill_buffer);
+	}
+	// NOTE: limits may have grown since the consumer sized the upload buffer,
+	// the mesh is written to cpu memory then
+	const bool fits_upload_buffer = slot.upload_buffer.size() >= mesh_size;
+	if (!_done && !fits_upload_buffer) {
+		try { 
+			slot.spill_buffer.resize(mesh_size); 
+		} catch (const std::exception&) {
+			_engine_context.error |= Error::CPU_ALLOCATION_FAILED;
+			_done = true;
 		}
+	}
 
-		MeshingTask meshing_task;
-		if (_meshing_tasks.read(meshing_task)) {
-			auto& staging_buffer = self.staging_buffers[self.current_buffer];
-			self.current_buffer = (self.current_buffer + 1) % self.staging_buffers.size();
-
-			auto value = greedyMeshing(staging_buffer,
-						meshing_task.chunk_position, meshing_task.voxel_data);
+	const auto& cancellation_token = _results.cancellationToken(slot.meshing_task.handle);
 
-			value.staging_buffer_in_use_flag = use_flag;
+	Promise value;
+	if (!_done && !cancellation_token.load(std::memory_order_relaxed)) {
+		value = greedyMeshing(fits_upload_buffer ? slot.upload_buffer : std::span<Vertex>(slot.spill_buffer),
+					slot.occupancy_masks, submesh_sizes,
+					slot.meshing_task.chunk_position, slot.meshing_task.voxel_data, &cancellation_token);
+	}
+	// NOTE: overflowed chunk is meshed again into a buffer which fits its real quad count
+	// (counting continues past the limit), other jobs aren't affected
+	if (value.overflow_flag && !_done && !cancellation_token.load(std::memory_order_relaxed)) {
+		std::array<std::size_t, 6> spill_submesh_sizes;
+		std::size_t spill_mesh_size{ 0UL };
+		for (std::size_t face{ 0UL }; face < 6UL; ++face) {
+			spill_submesh_sizes[face] = static_cast<std::size_t>(value.written_quads[face]) * VERTICES_PER_QUAD;
+			spill_mesh_size += spill_submesh_sizes[face];
+		}
+		try { 
+			slot.spill_buffer.resize(spill_mesh_size); 
+#ifdef ENGINE_TEST
+			// NOTE: timings include the first (overflowed) pass
+			const auto cmd_timer_meshing = value.cmd_timer_meshing;
+			const auto cmd_timer_real = value.cmd_timer_real;
+#endif
+			value = greedyMeshing(slot.spill_buffer, slot.occupancy_masks, spill_submesh_sizes,
+						slot.meshing_task.chunk_position, slot.meshing_task.voxel_data, &cancellation_token);
+			value.spilled = true;
+#ifdef ENGINE_TEST
+			value.cmd_timer_meshing = cmd_timer_meshing;
+			value.cmd_timer_real = cmd_timer_real;
+#endif
+		} catch (const std::exception&) {
+			_engine_context.error |= Error::CPU_ALLOCATION_FAILED;
+			_done = true;
+			// NOTE: quad counts of the overflowed pass exceed the buffer it was written to,
+			// an empty result is published instead
+			value = Promise{};
+		}
+	}
+	// NOTE: result of cancelled task is dropped by the consumer
+	const bool cancelled = cancellation_token.load(std::memory_order_relaxed);
+	value.overflow_flag = false;
+	value.staging_buffer_in_use_flag = &slot.in_use;
+	value.slot_index = slot_index;
+	value.in_upload_buffer = fits_upload_buffer && !value.spilled;
 #ifdef ENGINE_TEST	
-			value.cmd_timer_meshing.stop();
+	value.cmd_timer_meshing.stop();
 #endif
-			std::lock_guard lock_guard(m_overflowed);
-			// TODO: optimize this
-			if (overflowed) {
-				// NOTE: return back the command it will
-				// be served again after limits are updated
-				_meshing_tasks.write(std::move(meshing_task));
-			} else {
-				if (value.overflow_flag) {
-					overflowed = true;
-				} else {
-					value.staging_buffer_in_use_flag->store(true, std::memory_order_relaxed);
-				}
-				meshing_task.promise.set_value(std::move(value));
-			}
-		} else {
-            std::this_thread::yield();
+
+	std::size_t next_slot_index{ _slots.size() };
+	{
+		std::lock_guard lock_guard(_mutex);
+		// NOTE: cancelled results are dropped by the consumer, their staging
+		// buffer isn't locked so the slot is released right away
+		const bool release_slot = cancelled || _done;
+		if (release_slot) {
+			value.staging_buffer_in_use_flag = nullptr;
+		}
+		_results.complete(slot.meshing_task.handle, std::move(value));
+		if (release_slot) {
+			slot.in_use.store(false, std::memory_order_release);
 		}
 
-		if (overflowed) {
-			--_ready_counter;
-			std::unique_lock lk(m_overflowed);
-			cond_overflowed.wait(lk);
-
-			const std::size_t mesh_size = 
-				_engine_context.chunk_max_current_mesh_size/sizeof(Vertex);
-			for (auto& buffer : self.staging_buffers) {
-				try { buffer.resize(mesh_size); }
-				catch (const std::exception&) {
-					_engine_context.error |= Error::CPU_ALLOCATION_FAILED;
-					_done = true;
-				}
-			}
-			self.current_buffer = 0;
+		// NOTE: the job's thread is passed to the next queued task (in the released or
+		// any other free slot), otherwise job is finished and after that the mesher
+		// mustn't be accessed (it may be destroyed)
+		if (!_done) {
+			next_slot_index = reserveSlot();
+		}
+		if (next_slot_index == _slots.size() && --_jobs_count == 0U) {
+			// NOTE: notified under the lock, destructor can't proceed until it's released
+			_jobs_finished_cond_var.notify_all();
+		}
+	}
+	if (next_slot_index != _slots.size()) {
+		postJob(next_slot_index);
+	}
+}
+
+void CpuMesher::releaseStagingBuffer(std::atomic<bool>* staging_buffer_in_use_flag) noexcept {
+	staging_buffer_in_use_flag->store(false, std::memory_order_release);
+	schedule();
+}
+
+void CpuMesher::setUploadBuffer(std::size_t slot_index, std::span<Vertex> upload_buffer) noexcept {
+	_slots[slot_index].upload_buffer = upload_buffer;
+}
+
+void CpuMesher::publishLimits() noexcept {
+	const auto generation = _limits_generation.load(std::memory_order_relaxed);
+	_limits_generation.store(generation + 1UL, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	for (std::size_t face{ 0UL }; face < 6UL; ++face) {
+		_submesh_limits[face].store(_engine_context.chunk_max_current_submesh_sizes[face]/sizeof(Vertex), std::memory_order_relaxed);
+	}
+	_limits_generation.store(generation + 2UL, std::memory_order_release);
+}
 
-			++_ready_counter;
+std::array<std::size_t, 6> CpuMesher::loadLimits() const noexcept {
+	std::array<std::size_t, 6> limits;
+	for (;;) {
+		const auto generation = _limits_generation.load(std::memory_order_acquire);
+		if ((generation & 1UL) != 0UL) {
+			continue;
+		}
+		for (std::size_t face{ 0UL }; face < 6UL; ++face) {
+			limits[face] = _submesh_limits[face].load(std::memory_order_relaxed);
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (_limits_generation.load(std::memory_order_relaxed) == generation) {
+			return limits;
 		}
 	}
+}
 
+void CpuMesher::stop() noexcept {
+	std::unique_lock lock(_mutex);
+	_done = true;
+	// NOTE: posted jobs reference the mesher, wait until all of them are executed
+	_jobs_finished_cond_var.wait(lock, [this] { return _jobs_count == 0U; });
 }
 
-std::future<CpuMesher::Promise> CpuMesher::mesh(vmath::Vec3f32 chunk_position, std::span<const vmath::u16> voxel_data) noexcept {
-    // can throw but will never happen in practice
-	std::promise<Promise> promise;
-    std::future<Promise> result(promise.get_future());
-    
-    /// will never return false since size == max chunks count
-    _meshing_tasks.write(std::move(promise), chunk_position, voxel_data);
+CpuMesher::~CpuMesher() noexcept {
+	stop();
+}
+
+CpuMesher::Handle CpuMesher::mesh(vmath::Vec3f32 chunk_position, std::span<const vmath::u16> voxel_data) noexcept {
+	// NOTE: cancelled results hold their slots until they are taken by the consumer
+	const auto handle = _results.acquire();
+	if (handle == Results::INVALID_HANDLE) {
+		return handle;
+	}
+    _meshing_tasks.write(handle, chunk_position, voxel_data);
+	schedule();
 
-    return result;
+    return handle;
 }
 
-//#define GREEDY_MESHING_DONT_USE_FUTURES
+//#define GREEDY_MESHING_DONT_USE_TASK_POOL
 
 CpuMesher::Promise CpuMesher::greedyMeshing(
-		std::vector<Vertex>& out, 
+		std::span<Vertex> out, 
+		std::span<vmath::u64> occupancy_masks,
+		const std::array<std::size_t, 6>& submesh_sizes,
 		vmath::Vec3f32 chunk_position,
-		std::span<const vmath::u16> voxel_data) noexcept {
+		std::span<const vmath::u16> voxel_data,
+		const std::atomic_bool* cancellation_token) noexcept {
 	CpuMesher::Promise result;
 
-	const std::size_t mesh_size = 
-		_engine_context.chunk_max_current_mesh_size/sizeof(Vertex);
-	const std::size_t submesh_size = 
-		_engine_context.chunk_max_current_submesh_size/sizeof(Vertex);
-#ifndef GREEDY_MESHING_DONT_USE_FUTURES
-	std::array<std::future<GreedyMeshingPromise>, 6> futures;
-#endif
+	std::size_t mesh_size{ 0UL };
+	for (std::size_t face{ 0UL }; face < 6UL; ++face) {
+		result.submesh_offsets[face] = mesh_size;
+		mesh_size += submesh_sizes[face];
+	}
 #ifdef ENGINE_TEST
 	result.cmd_timer_meshing.start();
 	result.cmd_timer_real.start();
 #endif
+	if (_use_bitmask_kernel) {
+		buildOccupancyMasks(occupancy_masks, voxel_data);
+	}
+
+	std::array<GreedyMeshingFaceDescriptor, 6> descs;
 	for (u32 face{ 0 }; face < 6; ++face) {
 		auto axis = face / 2;
 		const Vec3u32 logical_indices {
@@ -157,6 +424,16 @@ CpuMesher::Promise CpuMesher::greedyMeshing(
 			_engine_context.chunk_size[logical_indices[1]],
 			_engine_context.chunk_size[logical_indices[2]]
 		};
+		const Vec3i32 world_strides {
+			1,
+			_engine_context.chunk_size[0],
+			_engine_context.chunk_size[0] * _engine_context.chunk_size[1]
+		};
+		const Vec3i32 logical_strides {
+			world_strides[logical_indices[0]],
+			world_strides[logical_indices[1]],
+			world_strides[logical_indices[2]]
+		};
 		
 		const i32 edge_value = (face % 2) == 1 ? 0 : logical_extent[2] - 1;
 		const i32 polarity   = (face % 2) == 1 ?-1 : 1;
@@ -168,127 +445,279 @@ CpuMesher::Promise CpuMesher::greedyMeshing(
 
     	const i32 plane_size = logical_extent[0] * logical_extent[1];
 
-		std::span<Vertex> out_subregion(out.data() + face * submesh_size, submesh_size);
-
-#ifdef GREEDY_MESHING_DONT_USE_FUTURES
-		const auto val = CpuMesher::greedyMeshingFace(
-			out_subregion, chunk_position, voxel_data,
-			GreedyMeshingFaceDescriptor{
-				static_cast<Face>(face),
-				axis,
-				logical_indices,
-				real_indices,
-				logical_extent,
-				edge_value,
-				polarity,
-				squashed_extent_logical_indices,
-				plane_size,
-				submesh_size
-			});
-		result.written_quads[face] = val.written_quads;
-		result.overflow_flag = result.overflow_flag || val.overflow_flag;
+		descs[face] = GreedyMeshingFaceDescriptor{
+			static_cast<Face>(face),
+			axis,
+			logical_indices,
+			real_indices,
+			logical_extent,
+			logical_strides,
+			edge_value,
+			polarity,
+			squashed_extent_logical_indices,
+			plane_size,
+			submesh_sizes[face]
+		};
+	}
+
+	std::array<GreedyMeshingPromise, 6> face_results;
+	const auto mesh_face = [&](std::size_t face) noexcept {
+		// NOTE: faces which didn't start before cancellation are skipped
+		if (cancellation_token != nullptr && cancellation_token->load(std::memory_order_relaxed)) {
+			face_results[face] = GreedyMeshingPromise{};
+			return;
+		}
+		std::span<Vertex> out_subregion(out.data() + result.submesh_offsets[face], submesh_sizes[face]);
+		face_results[face] = (this->*_face_kernels[face])(out_subregion, chunk_position, voxel_data, occupancy_masks, descs[face]);
+	};
+#ifdef GREEDY_MESHING_DONT_USE_TASK_POOL
+	for (std::size_t face{ 0 }; face < 6; ++face) {
+		mesh_face(face);
+	}
 #else
-		futures[face] = std::async(
-			&CpuMesher::greedyMeshingFace, this,
-			out_subregion, chunk_position, voxel_data,
-			GreedyMeshingFaceDescriptor{
-				static_cast<Face>(face),
-				axis,
-				logical_indices,
-				real_indices,
-				logical_extent,
-				edge_value,
-				polarity,
-				squashed_extent_logical_indices,
-				plane_size,
-				submesh_size
-			}
-		);
+	// NOTE: calling thread meshes the first face and helps with the rest
+	_engine_context.task_pool.parallelFor(6UL, mesh_face);
 #endif
-	}
 
-#ifndef GREEDY_MESHING_DONT_USE_FUTURES
 	for (u32 face{ 0 }; face < 6; ++face) {
-		const auto future_val = futures[face].get();
-		result.written_quads[face] = future_val.written_quads;
-		result.overflow_flag = result.overflow_flag || future_val.overflow_flag;
+		result.written_quads[face] = face_results[face].written_quads;
+		result.overflow_flag = result.overflow_flag || face_results[face].overflow_flag;
 	}
-#endif
 	result.staging_buffer_ptr = std::span<Vertex>(out.data(), mesh_size);
 
 	return result;
 }
 
+template<vmath::i32 EXTENT, bool BITMASK>
+static constexpr std::array<CpuMesher::FaceKernel, 6> FIXED_FACE_KERNELS{
+	&CpuMesher::meshFace<CpuMesher::FixedGreedyMeshingFaceDescriptor<EXTENT, X_POS>, BITMASK>,
+	&CpuMesher::meshFace<CpuMesher::FixedGreedyMeshingFaceDescriptor<EXTENT, X_NEG>, BITMASK>,
+	&CpuMesher::meshFace<CpuMesher::FixedGreedyMeshingFaceDescriptor<EXTENT, Y_POS>, BITMASK>,
+	&CpuMesher::meshFace<CpuMesher::FixedGreedyMeshingFaceDescriptor<EXTENT, Y_NEG>, BITMASK>,
+	&CpuMesher::meshFace<CpuMesher::FixedGreedyMeshingFaceDescriptor<EXTENT, Z_POS>, BITMASK>,
+	&CpuMesher::meshFace<CpuMesher::FixedGreedyMeshingFaceDescriptor<EXTENT, Z_NEG>, BITMASK>
+};
+
+template<bool BITMASK>
+static std::array<CpuMesher::FaceKernel, 6> selectFaceKernelsForChunkSize(Vec3i32 chunk_size) noexcept {
+	if (chunk_size[0] == chunk_size[1] && chunk_size[1] == chunk_size[2]) {
+		switch (chunk_size[0]) {
+			case 16: return FIXED_FACE_KERNELS<16, BITMASK>;
+			case 32: return FIXED_FACE_KERNELS<32, BITMASK>;
+			case 64: return FIXED_FACE_KERNELS<64, BITMASK>;
+			default: break;
+		}
+		if constexpr (!BITMASK) {
+			switch (chunk_size[0]) {
+				case 128: return FIXED_FACE_KERNELS<128, false>;
+				case 256: return FIXED_FACE_KERNELS<256, false>;
+				default: break;
+			}
+		}
+	}
+	constexpr auto generic_kernel = &CpuMesher::meshFace<CpuMesher::GreedyMeshingFaceDescriptor, BITMASK>;
+	return { generic_kernel, generic_kernel, generic_kernel, generic_kernel, generic_kernel, generic_kernel };
+}
+
+void CpuMesher::selectFaceKernels() noexcept {
+	constexpr auto max_bitmask_extent = static_cast<i32>(MAX_BITMASK_CHUNK_EXTENT);
+	// NOTE: columns of bigger chunks don't fit in the occupancy masks
+	_use_bitmask_kernel = _engine_context.cpu_meshing_kernel == CPU_MESHING_KERNEL_BITMASK &&
+		_engine_context.chunk_size[0] <= max_bitmask_extent &&
+		_engine_context.chunk_size[1] <= max_bitmask_extent &&
+		_engine_context.chunk_size[2] <= max_bitmask_extent;
+	_face_visibility_kernel = selectFaceVisibilityKernel(_engine_context.max_cpu_simd_level);
+	constexpr auto max_slice_extent = MAX_SLICE_VISIBILITY_CHUNK_EXTENT;
+	// NOTE: scalar bulk pass doesn't pay off its setup for small chunks
+	_use_slice_visibility = std::min(_engine_context.max_cpu_simd_level, supportedCpuSimdLevel()) == CPU_SIMD_LEVEL_SCALAR &&
+		_engine_context.chunk_size[0] <= max_slice_extent &&
+		_engine_context.chunk_size[1] <= max_slice_extent &&
+		_engine_context.chunk_size[2] <= max_slice_extent;
+	_face_kernels = _use_bitmask_kernel ?
+		selectFaceKernelsForChunkSize<true>(_engine_context.chunk_size) :
+		selectFaceKernelsForChunkSize<false>(_engine_context.chunk_size);
+}
+
+template<typename Descriptor, bool BITMASK>
+CpuMesher::GreedyMeshingPromise CpuMesher::meshFace(std::span<Vertex> out, 
+		vmath::Vec3f32 chunk_position,
+		std::span<const vmath::u16> voxel_data,
+		std::span<const vmath::u64> occupancy_masks,
+		const GreedyMeshingFaceDescriptor& desc
+) noexcept {
+	if constexpr (std::is_same_v<Descriptor, GreedyMeshingFaceDescriptor>) {
+		if constexpr (BITMASK) {
+			return greedyMeshingFaceBitmask(out, chunk_position, voxel_data, occupancy_masks, desc);
+		} else if (_use_slice_visibility) {
+			return greedyMeshingFaceSlices(out, chunk_position, voxel_data, desc);
+		} else {
+			return greedyMeshingFace(out, chunk_position, voxel_data, desc);
+		}
+	} else {
+		const Descriptor fixed_desc{ desc.max_submesh_size };
+		if constexpr (BITMASK) {
+			return greedyMeshingFaceBitmask(out, chunk_position, voxel_data, occupancy_masks, fixed_desc);
+		} else if (_use_slice_visibility) {
+			return greedyMeshingFaceSlices(out, chunk_position, voxel_data, fixed_desc);
+		} else {
+			return greedyMeshingFace(out, chunk_position, voxel_data, fixed_desc);
+		}
+	}
+}
+
+template<typename Descriptor>
 CpuMesher::GreedyMeshingPromise CpuMesher::greedyMeshingFace(std::span<Vertex> out, 
 		vmath::Vec3f32 chunk_position,
 		std::span<const vmath::u16> voxel_data,
-		GreedyMeshingFaceDescriptor desc
+		const Descriptor& desc
 ) noexcept {
 
-	static constexpr Vec3f32 VERTICES[8] = {
-		{0.f, 0.f, 0.f}, // 0
-		{0.f, 0.f, 1.f}, // 1
-		{0.f, 1.f, 0.f}, // 2 
-		{0.f, 1.f, 1.f}, // 3
-		{1.f, 0.f, 0.f}, // 4
-		{1.f, 0.f, 1.f}, // 5
-		{1.f, 1.f, 0.f}, // 6
-		{1.f, 1.f, 1.f}  // 7
-	};
-	static constexpr Vec2f32 TEX_COORDS[4] = {
-		{0.f, 0.f},
-		{1.f, 0.f},
-		{1.f, 1.f},
-		{0.f, 1.f}
+	GreedyMeshingPromise result{};
+
+	// NOTE: buffer is kept per worker thread, faces of a chunk are meshed in parallel
+	static thread_local std::vector<u64> states;
+	const auto voxels_count = static_cast<std::size_t>(desc.logical_extent[0]) *
+		static_cast<std::size_t>(desc.logical_extent[1]) * static_cast<std::size_t>(desc.logical_extent[2]);
+	try {
+		states.resize((voxels_count + 63UL) / 64UL);
+	} catch (const std::exception&) {
+		_engine_context.error |= Error::CPU_ALLOCATION_FAILED;
+		return result;
+	}
+	const auto state_index = [&desc](i32 x, i32 y, i32 slice) noexcept {
+		return static_cast<std::size_t>(
+			x * desc.logical_strides[0] + y * desc.logical_strides[1] + slice * desc.logical_strides[2]);
 	};
-	static constexpr std::size_t QUADS[6][4] = {
-		{ 5, 4, 6, 7 },
-		{ 0, 1, 3, 2 },
-		{ 2, 3, 7, 6 },
-		{ 4, 5, 1, 0 },
-		{ 1, 5, 7, 3 },
-		{ 4, 0, 2, 6 }
+	const auto visible = [](std::span<const u64> bits, std::size_t index) noexcept {
+		return ((bits[index / 64UL] >> (index % 64UL)) & 1UL) != 0UL;
 	};
-	
-	//std::array<bool, 64*64> states;
-	//std::fill(states.begin(), states.end(), false);
-	std::bitset<64 * 64> states(0);
-	GreedyMeshingPromise result{};
-	i32 vertices_writer{ 0 };
+
+	_face_visibility_kernel(states, voxel_data, static_cast<i64>(desc.polarity * desc.logical_strides[2]));
+
+	// NOTE: neighbours of the edge slice wrap around rows/planes in the flat pass,
+	// edge voxels are visible whenever they are solid
+	for (i32 y{ 0 }; y < desc.logical_extent[1]; ++y) {
+		for (i32 x{ 0 }; x < desc.logical_extent[0]; ++x) {
+			const auto index = state_index(x, y, desc.edge_value);
+			const auto bit = 1UL << (index % 64UL);
+			states[index / 64UL] = voxel_data[index] != 0 ?
+				(states[index / 64UL] | bit) : (states[index / 64UL] & ~bit);
+		}
+	}
+
+	std::bitset<static_cast<std::size_t>(MAX_CHUNK_EXTENT)> visible_slices;
+	for (std::size_t word{ 0UL }; word < states.size(); ++word) {
+		for (u64 bits{ states[word] }; bits != 0UL; bits &= bits - 1UL) {
+			const auto index = static_cast<i32>(word * 64UL) + std::countr_zero(bits);
+			visible_slices.set(static_cast<std::size_t>((index / desc.logical_strides[2]) % desc.logical_extent[2]));
+		}
+	}
+
+	u64 vertices_writer{ 0UL };
 	for (i32 slice{ 0 }; slice < desc.logical_extent[2]; ++slice) {
 		
+	if (!visible_slices[static_cast<std::size_t>(slice)])
+		continue;
+
 	Vec3i32 i{ 0, 0, slice };
-	bool any_visible{ false };
 
-	for (;i[1] < desc.logical_extent[1]; ++i[1]) {
-		for (i[0] = 0; i[0] < desc.logical_extent[0]; ++i[0]) {
-			const std::size_t voxel_index = 
-				i[desc.real_indices[0]] +
-				i[desc.real_indices[1]] * desc.logical_extent[0] +
-				i[desc.real_indices[2]] * desc.plane_size;
-			
-			if (voxel_data[voxel_index] == 0)
+	for (i[1] = 0; i[1] < desc.logical_extent[1]; ++i[1]) {
+		for (i[0] = 0; i[0] < desc.logical_extent[0];) {
+			if (!visible(states, state_index(i[0], i[1], slice))) {
+				++i[0];
 				continue;
+			}
+			// NOTE: values are read through the same (real strides) index as
+			// visibility, so non-cubic chunks are indexed correctly
+			const auto voxel_value = voxel_data[state_index(i[0], i[1], slice)];
 
-			if (i[2] == desc.edge_value) {
-				states[i[0] + i[1] * desc.logical_extent[0]] = true;
-				any_visible = true;			
-				continue;
+			Vec3i32 mesh_region = Vec3i32(1, 0, 0);
+
+			for (;i[0] + mesh_region[0] < desc.logical_extent[0]; ++mesh_region[0]) {
+				if (!visible(states, state_index(i[0] + mesh_region[0], i[1], slice)))
+					break;
+
+				const auto next_voxel_value = voxel_data[state_index(i[0] + mesh_region[0], i[1], slice)];
+				
+				if (voxel_value != next_voxel_value)
+					break;
+			}
+
+			const i32 mesh_region_x = mesh_region[0];
+			mesh_region[0] = 0;
+
+			for (mesh_region[1] = 1; i[1] + mesh_region[1] < desc.logical_extent[1]; ++mesh_region[1]) {
+				Vec3i32 tmp_mesh_region{ 0, 0, 0 };
+				bool outer_break{ false };
+				for (;i[0] + tmp_mesh_region[0] < i[0] + mesh_region_x; ++tmp_mesh_region[0]) {
+					if (!visible(states, state_index(i[0] + tmp_mesh_region[0], i[1] + mesh_region[1], slice))) {
+						outer_break = true;
+						break;
+					}
+
+					const auto next_voxel_value = voxel_data[state_index(i[0] + tmp_mesh_region[0], i[1] + mesh_region[1], slice)];
+
+					if (voxel_value != next_voxel_value) {
+						outer_break = true;
+						break;
+					}
+				}
+				if (outer_break)
+					break;
 			}
 
-			i[2] += desc.polarity; // BEGIN
+			mesh_region[0] = mesh_region_x;
 
-			const std::size_t neighbouring_voxel_index = 
-				i[desc.real_indices[0]] +
-				i[desc.real_indices[1]] * desc.logical_extent[0] +
-				i[desc.real_indices[2]] * desc.plane_size;
+			if (vertices_writer + VERTICES_PER_QUAD > desc.max_submesh_size) {
+				result.overflow_flag = true;
+			} else {
+				writeQuad(out.data() + vertices_writer, desc, chunk_position, i, mesh_region, voxel_value);
+			}
 
-			if (voxel_data[neighbouring_voxel_index] == 0) {
-				states[i[0] + i[1] * desc.logical_extent[0]] = true;
-				any_visible = true;			
+			vertices_writer += VERTICES_PER_QUAD;
+			for (int y = i[1]; y < i[1] + mesh_region[1]; ++y) {
+				for (int x = i[0]; x < i[0] + mesh_region[0]; ++x) {
+					const auto index = state_index(x, y, slice);
+					states[index / 64UL] &= ~(1UL << (index % 64UL));
+				}
 			}
 
-			i[2] -= desc.polarity; // END
+			i[0] += mesh_region[0];
+		}
+	}
+	}
+	result.written_quads = static_cast<u32>(vertices_writer/VERTICES_PER_QUAD);
+	return result;
+}
+
+template<typename Descriptor>
+CpuMesher::GreedyMeshingPromise CpuMesher::greedyMeshingFaceSlices(std::span<Vertex> out, 
+		vmath::Vec3f32 chunk_position,
+		std::span<const vmath::u16> voxel_data,
+		const Descriptor& desc
+) noexcept {
+
+	std::bitset<Descriptor::STATES_SIZE> states(0);
+	GreedyMeshingPromise result{};
+	const auto voxel_index = [&desc](i32 x, i32 y, i32 slice) noexcept {
+		return static_cast<std::size_t>(
+			x * desc.logical_strides[0] + y * desc.logical_strides[1] + slice * desc.logical_strides[2]);
+	};
+	u64 vertices_writer{ 0UL };
+	for (i32 slice{ 0 }; slice < desc.logical_extent[2]; ++slice) {
+		
+	Vec3i32 i{ 0, 0, slice };
+	bool any_visible{ false };
+
+	for (;i[1] < desc.logical_extent[1]; ++i[1]) {
+		for (i[0] = 0; i[0] < desc.logical_extent[0]; ++i[0]) {
+			if (voxel_data[voxel_index(i[0], i[1], slice)] == 0)
+				continue;
+
+			if (slice == desc.edge_value || voxel_data[voxel_index(i[0], i[1], slice + desc.polarity)] == 0) {
+				states[i[0] + i[1] * desc.logical_extent[0]] = true;
+				any_visible = true;
+			}
 		}
 	}
 
@@ -301,26 +730,15 @@ CpuMesher::GreedyMeshingPromise CpuMesher::greedyMeshingFace(std::span<Vertex> o
 				++i[0];
 				continue;
 			}
-			const std::size_t voxel_index = 
-				i[desc.real_indices[0]] +
-				i[desc.real_indices[1]] * desc.logical_extent[0] +
-				i[desc.real_indices[2]] * desc.plane_size;
-			const auto voxel_value = voxel_data[voxel_index];
+			const auto voxel_value = voxel_data[voxel_index(i[0], i[1], slice)];
 
 			Vec3i32 mesh_region = Vec3i32(1, 0, 0);
 
 			for (;i[0] + mesh_region[0] < desc.logical_extent[0]; ++mesh_region[0]) {
-				const std::size_t state_index =
-					(i[0] + mesh_region[0]) + i[1] * desc.logical_extent[0];
-
-				if (!states[state_index])
+				if (!states[(i[0] + mesh_region[0]) + i[1] * desc.logical_extent[0]])
 					break;
 
-				const std::size_t next_voxel_index =
-					(i[desc.real_indices[0]] + mesh_region[desc.real_indices[0]]) + 
-					(i[desc.real_indices[1]] + mesh_region[desc.real_indices[1]]) * desc.logical_extent[0] + 
-					(i[desc.real_indices[2]] + mesh_region[desc.real_indices[2]]) * desc.plane_size;
-				const auto next_voxel_value = voxel_data[next_voxel_index];
+				const auto next_voxel_value = voxel_data[voxel_index(i[0] + mesh_region[0], i[1], slice)];
 				
 				if (voxel_value != next_voxel_value)
 					break;
@@ -333,18 +751,12 @@ CpuMesher::GreedyMeshingPromise CpuMesher::greedyMeshingFace(std::span<Vertex> o
 				Vec3i32 tmp_mesh_region{ 0, 0, 0 };
 				bool outer_break{ false };
 				for (;i[0] + tmp_mesh_region[0] < i[0] + mesh_region_x; ++tmp_mesh_region[0]) {
-					const std::size_t state_index =
-						(i[0] + tmp_mesh_region[0]) + (i[1] + mesh_region[1]) * desc.logical_extent[0];
-					if (!states[state_index]) {
+					if (!states[(i[0] + tmp_mesh_region[0]) + (i[1] + mesh_region[1]) * desc.logical_extent[0]]) {
 						outer_break = true;
 						break;
 					}
 
-					const std::size_t next_voxel_index =
-						(i[desc.real_indices[0]] + mesh_region[desc.real_indices[0]] + tmp_mesh_region[desc.real_indices[0]]) + 
-						(i[desc.real_indices[1]] + mesh_region[desc.real_indices[1]] + tmp_mesh_region[desc.real_indices[1]]) * desc.logical_extent[0] + 
-						(i[desc.real_indices[2]] + mesh_region[desc.real_indices[2]] + tmp_mesh_region[desc.real_indices[2]]) * desc.plane_size;
-					const auto next_voxel_value = voxel_data[next_voxel_index];
+					const auto next_voxel_value = voxel_data[voxel_index(i[0] + tmp_mesh_region[0], i[1] + mesh_region[1], slice)];
 
 					if (voxel_value != next_voxel_value) {
 						outer_break = true;
@@ -357,51 +769,13 @@ CpuMesher::GreedyMeshingPromise CpuMesher::greedyMeshingFace(std::span<Vertex> o
 
 			mesh_region[0] = mesh_region_x;
 
-			Vec3f32 region_extent{ 0.f, 0.f, 0.f };
-			region_extent[desc.logical_indices[2]] = 1.f;
-			region_extent[desc.logical_indices[1]] = static_cast<f32>(mesh_region[1]);
-			region_extent[desc.logical_indices[0]] = static_cast<f32>(mesh_region[0]);
-
-			Vec2f32 squashed_region_extent {
-				static_cast<f32>(mesh_region[desc.squashed_extent_logical_indices[0]]),
-				static_cast<f32>(mesh_region[desc.squashed_extent_logical_indices[1]])
-			};
-
-			Vec3f32 region_offset = chunk_position;
-			region_offset[desc.logical_indices[2]] += static_cast<float>(i[2]);
-			region_offset[desc.logical_indices[1]] += static_cast<float>(i[1]);
-			region_offset[desc.logical_indices[0]] += static_cast<float>(i[0]);
-			
-
-			if (vertices_writer + 4 > desc.max_submesh_size) {
+			if (vertices_writer + VERTICES_PER_QUAD > desc.max_submesh_size) {
 				result.overflow_flag = true;
 			} else {
-				const auto voxel_value_encoded = static_cast<f32>(6 * (voxel_value - 1)) + static_cast<f32>(desc.face);
-				Vertex v[4];
-				v[0].position = Vec3f32::add(Vec3f32::mul(region_extent, VERTICES[QUADS[desc.face][0]]), region_offset);
-				v[0].texcoord[0] = squashed_region_extent[0] * TEX_COORDS[0][0];
-				v[0].texcoord[1] = squashed_region_extent[1] * TEX_COORDS[0][1];
-				v[0].texcoord[2] = voxel_value_encoded;
-
-				v[1].position = Vec3f32::add(Vec3f32::mul(region_extent, VERTICES[QUADS[desc.face][1]]), region_offset);
-				v[1].texcoord[0] = squashed_region_extent[0] * TEX_COORDS[1][0];
-				v[1].texcoord[1] = squashed_region_extent[1] * TEX_COORDS[1][1];
-				v[1].texcoord[2] = voxel_value_encoded;
-
-				v[2].position = Vec3f32::add(Vec3f32::mul(region_extent, VERTICES[QUADS[desc.face][2]]), region_offset);
-				v[2].texcoord[0] = squashed_region_extent[0] * TEX_COORDS[2][0];
-				v[2].texcoord[1] = squashed_region_extent[1] * TEX_COORDS[2][1];
-				v[2].texcoord[2] = voxel_value_encoded;
-
-				v[3].position = Vec3f32::add(Vec3f32::mul(region_extent, VERTICES[QUADS[desc.face][3]]), region_offset);
-				v[3].texcoord[0] = squashed_region_extent[0] * TEX_COORDS[3][0];
-				v[3].texcoord[1] = squashed_region_extent[1] * TEX_COORDS[3][1];
-				v[3].texcoord[2] = voxel_value_encoded;
-			
-				memcpy(out.data() + vertices_writer, v, sizeof(v));
+				writeQuad(out.data() + vertices_writer, desc, chunk_position, i, mesh_region, voxel_value);
 			}
 
-			vertices_writer += 4;
+			vertices_writer += VERTICES_PER_QUAD;
 			for (int y = i[1]; y < i[1] + mesh_region[1]; ++y)
 				for (int x = i[0]; x < i[0] + mesh_region[0]; ++x)
 					states[x + y * desc.logical_extent[0]] = false;
@@ -410,6 +784,121 @@ CpuMesher::GreedyMeshingPromise CpuMesher::greedyMeshingFace(std::span<Vertex> o
 		}
 	}
 	}
-	result.written_quads = vertices_writer/4;
+	result.written_quads = static_cast<u32>(vertices_writer/VERTICES_PER_QUAD);
+	return result;
+}
+
+void CpuMesher::buildOccupancyMasks(std::span<vmath::u64> out, std::span<const vmath::u16> voxel_data) const noexcept {
+	std::fill(out.begin(), out.end(), 0UL);
+
+	// masks are indexed with (logical x, logical y) of the axis and bits go along the axis
+	// X axis -> (y, z), Y axis -> (z, x), Z axis -> (x, y)
+	u64* x_masks = out.data() + 0 * OCCUPANCY_MASKS_PER_AXIS;
+	u64* y_masks = out.data() + 1 * OCCUPANCY_MASKS_PER_AXIS;
+	u64* z_masks = out.data() + 2 * OCCUPANCY_MASKS_PER_AXIS;
+
+	const auto& size = _engine_context.chunk_size;
+	std::size_t voxel_index{ 0UL };
+	for (i32 z{ 0 }; z < size[2]; ++z) {
+		for (i32 y{ 0 }; y < size[1]; ++y) {
+			u64 x_mask{ 0UL };
+			for (i32 x{ 0 }; x < size[0]; ++x) {
+				const auto solid = static_cast<u64>(voxel_data[voxel_index++] != 0);
+				x_mask |= solid << x;
+				y_masks[z + x * MAX_BITMASK_CHUNK_EXTENT] |= solid << y;
+				z_masks[x + y * MAX_BITMASK_CHUNK_EXTENT] |= solid << z;
+			}
+			x_masks[y + z * MAX_BITMASK_CHUNK_EXTENT] = x_mask;
+		}
+	}
+}
+
+template<typename Descriptor>
+CpuMesher::GreedyMeshingPromise CpuMesher::greedyMeshingFaceBitmask(std::span<Vertex> out, 
+		vmath::Vec3f32 chunk_position,
+		std::span<const vmath::u16> voxel_data,
+		std::span<const vmath::u64> occupancy_masks,
+		const Descriptor& desc
+) noexcept {
+	// states[slice * MAX_BITMASK_CHUNK_EXTENT + y] holds visible faces of a row, bits go along logical x
+	std::array<u64, MAX_BITMASK_CHUNK_EXTENT * MAX_BITMASK_CHUNK_EXTENT> states;
+	// bit y of slice_rows[slice] is set if row y of the slice has any visible face
+	std::array<u64, MAX_BITMASK_CHUNK_EXTENT> slice_rows;
+	std::fill(slice_rows.begin(), slice_rows.end(), 0UL);
+	std::fill(states.begin(), states.begin() + desc.logical_extent[2] * MAX_BITMASK_CHUNK_EXTENT, 0UL);
+
+	// visible faces are found along the axis (a column) and scattered to the slices
+	const u64* axis_masks = occupancy_masks.data() + desc.axis * OCCUPANCY_MASKS_PER_AXIS;
+	for (i32 y{ 0 }; y < desc.logical_extent[1]; ++y) {
+		for (i32 x{ 0 }; x < desc.logical_extent[0]; ++x) {
+			const u64 column = axis_masks[x + y * MAX_BITMASK_CHUNK_EXTENT];
+			u64 visible = desc.polarity > 0 ? 
+				(column & ~(column >> 1)) : 
+				(column & ~(column << 1));
+			while (visible != 0) {
+				const auto slice = std::countr_zero(visible);
+				visible &= visible - 1;
+				states[slice * MAX_BITMASK_CHUNK_EXTENT + y] |= (1UL << x);
+				slice_rows[slice] |= (1UL << y);
+			}
+		}
+	}
+
+	const i32 x_stride = desc.logical_strides[0];
+	const i32 y_stride = desc.logical_strides[1];
+	const i32 slice_stride = desc.logical_strides[2];
+
+	GreedyMeshingPromise result{};
+	u64 vertices_writer{ 0UL };
+	for (i32 slice{ 0 }; slice < desc.logical_extent[2]; ++slice) {
+		u64* slice_states = states.data() + slice * MAX_BITMASK_CHUNK_EXTENT;
+		const u16* slice_voxels = voxel_data.data() + slice * slice_stride;
+
+		for (u64 rows = slice_rows[slice]; rows != 0; rows &= rows - 1) {
+			const auto y = std::countr_zero(rows);
+			u64& row = slice_states[y];
+			while (row != 0) {
+				const auto x = std::countr_zero(row);
+				const u16* voxel = slice_voxels + x * x_stride + y * y_stride;
+				const auto voxel_value = *voxel;
+
+				// set bits following x bound the width, then values are compared
+				const auto max_width = std::countr_zero(~(row >> x));
+				i32 width{ 1 };
+				while (width < max_width && voxel[width * x_stride] == voxel_value) {
+					++width;
+				}
+				const u64 width_mask = (width == 64 ? ~0UL : ((1UL << width) - 1UL)) << x;
+
+				i32 height{ 1 };
+				for (; y + height < desc.logical_extent[1]; ++height) {
+					if ((slice_states[y + height] & width_mask) != width_mask) {
+						break;
+					}
+					const u16* next_row_voxel = voxel + height * y_stride;
+					i32 w{ 0 };
+					while (w < width && next_row_voxel[w * x_stride] == voxel_value) {
+						++w;
+					}
+					if (w != width) {
+						break;
+					}
+				}
+
+				if (vertices_writer + VERTICES_PER_QUAD > desc.max_submesh_size) {
+					result.overflow_flag = true;
+				} else {
+					writeQuad(out.data() + vertices_writer, desc, chunk_position, 
+						{ x, y, slice }, { width, height, 0 }, voxel_value);
+				}
+				vertices_writer += VERTICES_PER_QUAD;
+
+				for (i32 h{ 0 }; h < height; ++h) {
+					slice_states[y + h] &= ~width_mask;
+				}
+			}
+		}
+	}
+	result.written_quads = static_cast<u32>(vertices_writer/VERTICES_PER_QUAD);
 	return result;
 }
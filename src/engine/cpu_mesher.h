@@ -2,15 +2,19 @@
 #define VE001_CPU_MESHER_H
 
 #include <span>
+#include <vector>
 #include <thread>
 #include <atomic>
-#include <future>
+#include <mutex>
+#include <condition_variable>
 #include <bitset>
 
 #include <vmath/vmath.h>
 
-#include "threadsafe_ringbuffer.h"
+#include "mpmc_ringbuffer.h"
+#include "completion_slots.h"
 #include "engine_context.h"
+#include "face_visibility.h"
 
 #include "vertex.h"
 
@@ -23,92 +27,243 @@ namespace ve001 {
 struct CpuMesher {
 	struct Promise {
 		std::span<const Vertex> staging_buffer_ptr;
+		/// @brief offsets (in vertices) of faces' subregions in <staging_buffer_ptr>
+		std::array<vmath::u64, 6> submesh_offsets{{0}};
+		/// @brief flag to release after staging buffer is consumed, nullptr
+		/// if staging buffer wasn't locked (cancelled result)
 		std::atomic<bool>* staging_buffer_in_use_flag{ nullptr };
+		/// @brief slot which produced the result (index in <_slots>)
+		std::size_t slot_index{ 0UL };
+		/// @brief mesh was written straight into the slot's upload buffer, otherwise
+		/// <staging_buffer_ptr> points to slot's cpu memory
+		bool in_upload_buffer{ false };
 		std::array<vmath::u32, 6> written_quads{{0}};
         bool overflow_flag{ false };
+		/// @brief mesh didn't fit the current limits and was meshed again into slot's
+		/// spill buffer, <staging_buffer_ptr> points to it (subregions fit the quads exactly)
+		bool spilled{ false };
 #ifdef ENGINE_TEST
 		Timer cmd_timer_meshing;
 		Timer cmd_timer_real;
 #endif
 	};
+	using Results = CompletionSlots<Promise>;
+	using Handle = Results::Handle;
+
 	struct MeshingTask {
-		std::promise<Promise> promise;
+		/// @brief slot to which the result is written
+		Handle handle;
 		vmath::Vec3f32 chunk_position;
 		std::span<const vmath::u16> voxel_data;
 	};
-	struct Thread {
-		std::array<std::vector<Vertex>, 1> staging_buffers;
-		std::array<std::atomic<bool>, 1> staging_buffer_in_use_flags;
-		std::size_t current_buffer{ 0UL };
-		std::jthread jthread;
-		Thread() : staging_buffer_in_use_flags{}  {
-			for (auto& f : staging_buffer_in_use_flags)
-				f.store(false, std::memory_order_relaxed);
-		}
-		Thread(const Thread& other) {
-			for (std::size_t i{ 0 }; i < staging_buffer_in_use_flags.size(); ++i)
-				staging_buffer_in_use_flags[i].store(
-						other.staging_buffer_in_use_flags[i].load(std::memory_order_relaxed),
-						std::memory_order_relaxed);
-		}
+	/// @brief max extent of a chunk along any axis handled by the bitmask kernel (a column
+	/// has to fit in a 64-bit mask), bigger chunks are meshed by the naive kernel
+	static constexpr std::size_t MAX_BITMASK_CHUNK_EXTENT{ 64UL };
+	/// @brief number of 64-bit occupancy masks (columns) per axis
+	static constexpr std::size_t OCCUPANCY_MASKS_PER_AXIS{ MAX_BITMASK_CHUNK_EXTENT * MAX_BITMASK_CHUNK_EXTENT };
+	/// @brief max extent of a chunk along any axis for which the scalar naive kernel
+	/// tests visibility per slice instead of the bulk pass (it's faster for small chunks)
+	static constexpr vmath::i32 MAX_SLICE_VISIBILITY_CHUNK_EXTENT{ 64 };
+
+	/// @brief state of a single meshing job. Slot is reserved when the job is
+	/// posted and released once its staging buffer is consumed
+	struct Slot {
+		MeshingTask meshing_task;
+		/// @brief memory mapped by the consumer (eg. persistently mapped gpu buffer) to
+		/// which meshes are written directly, it's swapped only while the slot is reserved
+		std::span<Vertex> upload_buffer;
+		/// @brief buffer sized to the real quad count of the chunk which overflowed
+		/// <upload_buffer> (or to the current limits if <upload_buffer> is too small
+		/// for them), it's freed by the next job of the slot
+		std::vector<Vertex> spill_buffer;
+		/// @brief occupancy column masks of currently meshed chunk (used
+		/// by bitmask kernel), 3 * OCCUPANCY_MASKS_PER_AXIS
+		std::vector<vmath::u64> occupancy_masks;
+		std::atomic<bool> in_use{ false };
 	};
 	struct GreedyMeshingPromise {
 		vmath::u32 written_quads{ 0 };
         bool overflow_flag{ false };
 	};
 	struct GreedyMeshingFaceDescriptor {
+		/// @brief number of visibility states of a slice of the per slice naive kernel
+		static constexpr std::size_t STATES_SIZE{
+			static_cast<std::size_t>(MAX_SLICE_VISIBILITY_CHUNK_EXTENT * MAX_SLICE_VISIBILITY_CHUNK_EXTENT) };
+
 		Face face;
 		vmath::u32 axis;
 		vmath::Vec3u32 logical_indices;
 		vmath::Vec3u32 real_indices;
 		vmath::Vec3i32 logical_extent;
+		/// @brief strides of logical x, y and slice in voxel data
+		vmath::Vec3i32 logical_strides;
 		vmath::i32 edge_value;
 		vmath::i32 polarity;
 		vmath::Vec2u32 squashed_extent_logical_indices;
 		vmath::i32 plane_size;
 		vmath::u64 max_submesh_size;
 	};
-    /// @brief allocated threads
-	std::vector<Thread> _threads;
-    /// @brief counts number of threads' which are already
-    /// initialized
-    std::atomic_int32_t _ready_counter{ 0 };
-    /// @brief threads' exit condition
+	/// @brief compile-time counterpart of GreedyMeshingFaceDescriptor for cubic chunks
+	/// of <EXTENT>, only the submesh size is known at runtime. Kernels instantiated with it
+	/// have constant loop bounds and index permutations
+	template<vmath::i32 EXTENT, Face FACE>
+	struct FixedGreedyMeshingFaceDescriptor {
+		static constexpr std::size_t STATES_SIZE{ static_cast<std::size_t>(EXTENT * EXTENT) };
+
+		static constexpr Face face{ FACE };
+		static constexpr vmath::u32 axis{ FACE / 2U };
+		static constexpr vmath::Vec3u32 logical_indices{ (axis + 1U) % 3U, (axis + 2U) % 3U, axis };
+		static constexpr vmath::Vec3u32 real_indices{ (2U + axis * 2U) % 3U, (0U + axis * 2U) % 3U, (1U + axis * 2U) % 3U };
+		static constexpr vmath::Vec3i32 logical_extent{ EXTENT, EXTENT, EXTENT };
+		static constexpr vmath::Vec3i32 logical_strides{
+			axis == 0U ? EXTENT : (axis == 1U ? EXTENT * EXTENT : 1),
+			axis == 0U ? EXTENT * EXTENT : (axis == 1U ? 1 : EXTENT),
+			axis == 0U ? 1 : (axis == 1U ? EXTENT : EXTENT * EXTENT)
+		};
+		static constexpr vmath::i32 edge_value{ (FACE % 2U) == 1U ? 0 : EXTENT - 1 };
+		static constexpr vmath::i32 polarity{ (FACE % 2U) == 1U ? -1 : 1 };
+		static constexpr vmath::Vec2u32 squashed_extent_logical_indices{ 
+			static_cast<vmath::u32>(axis == 0U), 
+			static_cast<vmath::u32>(axis != 0U)
+		};
+		static constexpr vmath::i32 plane_size{ EXTENT * EXTENT };
+
+		vmath::u64 max_submesh_size;
+	};
+	/// @brief meshes a single face, kernels are selected for chunk size by selectFaceKernels
+	using FaceKernel = GreedyMeshingPromise (CpuMesher::*)(std::span<Vertex> out,
+			vmath::Vec3f32 chunk_position,
+			std::span<const vmath::u16> voxel_data,
+			std::span<const vmath::u64> occupancy_masks,
+			const GreedyMeshingFaceDescriptor& desc) noexcept;
+	/// @brief slots of meshing jobs, <cpu_mesher_slots_per_thread> per each thread
+	/// so that a thread can mesh while previous result waits for upload
+	std::vector<Slot> _slots;
+    /// @brief jobs' exit condition
     std::atomic_bool _done{ false };
-	/// @brief signals to thread that buffers are too small
-	/// and it should stop meshing until updateLimits is called
-	//std::atomic_bool overflowed{ false };
-	bool overflowed{ false };
-	std::condition_variable cond_overflowed;
-	std::mutex m_overflowed;
+	/// @brief number of posted jobs which haven't yet finished
+	vmath::u32 _jobs_count{ 0U };
+	/// @brief max number of jobs meshing at once, slots above it only hold
+	/// results waiting for upload
+	vmath::u32 _threads_count{ 1U };
+	/// @brief guards slots' reservation and <_jobs_count>
+	std::mutex _mutex;
+	/// @brief signaled when last job finishes
+	std::condition_variable _jobs_finished_cond_var;
+	/// @brief kernel of each face, specialized for 16/32/64/128/256 cubic chunks
+	/// or generic (runtime descriptor) for other sizes
+	std::array<FaceKernel, 6> _face_kernels{};
+	/// @brief if the bitmask kernel is used, false if it was requested but the chunk
+	/// is too big for it
+	bool _use_bitmask_kernel{ false };
+	/// @brief visibility pass of the naive kernel, picked for the cpu
+	FaceVisibilityKernel _face_visibility_kernel{ nullptr };
+	/// @brief if the naive kernel tests visibility per slice, true if only the scalar
+	/// pass is available and the chunk fits MAX_SLICE_VISIBILITY_CHUNK_EXTENT
+	bool _use_slice_visibility{ false };
+	/// @brief limits (sizes of faces' subregions in vertices) published by the consumer,
+	/// jobs never read them from engine context which is written by the consumer's thread
+	std::array<std::atomic<vmath::u64>, 6> _submesh_limits{};
+	/// @brief odd while <_submesh_limits> are written, jobs retry reading until they
+	/// see the same even generation before and after the read (seqlock)
+	std::atomic<vmath::u64> _limits_generation{ 0UL };
 	/// @brief promise queue for meshing task
-	ThreadSafeRingBuffer<MeshingTask> _meshing_tasks;
+	MPMCRingBuffer<MeshingTask> _meshing_tasks;
+	/// @brief slots of meshing results, one per each chunk which can be
+	/// meshed at once (capacity)
+	Results _results;
 
 	const EngineContext& _engine_context;
 
+	/// @param threads_count max number of task pool's workers meshing at once, if 0
+	/// then all of the task pool's workers can be used
 	CpuMesher(const EngineContext& engine_context, vmath::u32 threads_count, std::size_t capacity) noexcept;
 	
-	void updateLimits() noexcept;
-    /// @brief threads' entry point
-    void thread(std::size_t thread_index) noexcept;
-    /// @brief signals if chunk data streamer was fully initialized
-    /// @return true if chunk data streamer is initialzed
-    bool ready() const noexcept { return _ready_counter == _threads.size(); }
+	/// @brief reserves free slots for queued tasks and posts their jobs
+	void schedule() noexcept;
+	/// @brief reserves a free slot for the next queued task, called under <_mutex>
+	/// @return index of the reserved slot or _slots.size() if there is no free
+	/// slot or no queued task
+	std::size_t reserveSlot() noexcept;
+	/// @brief posts meshing job of a reserved slot to engine's task pool
+	void postJob(std::size_t slot_index) noexcept;
+	/// @brief meshing job's entry point
+	void job(std::size_t slot_index) noexcept;
+	/// @brief releases staging buffer of consumed result
+	/// @param staging_buffer_in_use_flag flag from Promise
+	void releaseStagingBuffer(std::atomic<bool>* staging_buffer_in_use_flag) noexcept;
+	/// @brief sets memory to which jobs of the slot write meshes, slot mustn't be
+	/// meshing (its result wasn't released yet or no task was issued)
+	void setUploadBuffer(std::size_t slot_index, std::span<Vertex> upload_buffer) noexcept;
+	/// @brief publishes current limits from engine context to jobs, called by the
+	/// consumer's thread after the limits change
+	void publishLimits() noexcept;
+	/// @brief consistent snapshot of published limits, called by jobs
+	std::array<std::size_t, 6> loadLimits() const noexcept;
+	/// @brief finishes posted jobs and stops accepting new ones, the mesher can't be used
+	/// afterwards. Called before memory of upload buffers is freed
+	void stop() noexcept;
 	/// @brief meshes a chunk
 	/// @param chunk_position real position of the chunk
 	/// @param voxel_data voxel data/chunk data from which mesh should be built
-	std::future<Promise> mesh(vmath::Vec3f32 chunk_position, std::span<const vmath::u16> voxel_data) noexcept;
+	/// @return handle to slot in <_results> to which the result is written, the value
+	/// has to be taken out with _results.get() to release the slot. Task can be cancelled
+	/// with _results.cancel(), then meshing is skipped or stopped early. INVALID_HANDLE
+	/// if all of the result slots are taken (task isn't queued then)
+	Handle mesh(vmath::Vec3f32 chunk_position, std::span<const vmath::u16> voxel_data) noexcept;
 
-	Promise greedyMeshing(std::vector<Vertex>& out, 
+	/// @brief meshes a chunk into the 6 subregions of <out>, subregions are laid out
+	/// one after another in Face order
+	/// @param submesh_sizes sizes of faces' subregions in vertices
+	/// @param cancellation_token if set, faces which weren't meshed yet are skipped (optional)
+	Promise greedyMeshing(std::span<Vertex> out, 
+			std::span<vmath::u64> occupancy_masks,
+			const std::array<std::size_t, 6>& submesh_sizes,
 			vmath::Vec3f32 chunk_position,
-			std::span<const vmath::u16> voxel_data) noexcept;
+			std::span<const vmath::u16> voxel_data,
+			const std::atomic_bool* cancellation_token = nullptr) noexcept;
+	/// @brief picks <_face_kernels> for engine's chunk size and cpu meshing kernel
+	void selectFaceKernels() noexcept;
+	/// @brief entry of a face kernel, runtime descriptor is replaced by <Descriptor>
+	template<typename Descriptor, bool BITMASK>
+	GreedyMeshingPromise meshFace(std::span<Vertex> out, 
+			vmath::Vec3f32 chunk_position,
+			std::span<const vmath::u16> voxel_data,
+			std::span<const vmath::u64> occupancy_masks,
+			const GreedyMeshingFaceDescriptor& desc
+	) noexcept;
+	/// @brief visible faces of the whole chunk are computed in bulk by <_face_visibility_kernel>
+	/// (bit per voxel, indexed as voxel data), quads are merged per slice
+	template<typename Descriptor>
 	GreedyMeshingPromise greedyMeshingFace(std::span<Vertex> out, 
 			vmath::Vec3f32 chunk_position,
 			std::span<const vmath::u16> voxel_data,
-			GreedyMeshingFaceDescriptor
+			const Descriptor& desc
+	) noexcept;
+	/// @brief variant of greedyMeshingFace which tests visibility of each slice before
+	/// merging it, produces exactly the same quads
+	template<typename Descriptor>
+	GreedyMeshingPromise greedyMeshingFaceSlices(std::span<Vertex> out, 
+			vmath::Vec3f32 chunk_position,
+			std::span<const vmath::u16> voxel_data,
+			const Descriptor& desc
+	) noexcept;
+	/// @brief builds occupancy column masks of a chunk. For each axis there is a
+	/// mask per (logical x, logical y) pair where bit n tells if voxel n along the axis is solid
+	/// @param out destination masks (3 * OCCUPANCY_MASKS_PER_AXIS)
+	/// @param voxel_data chunk's voxel data
+	void buildOccupancyMasks(std::span<vmath::u64> out, std::span<const vmath::u16> voxel_data) const noexcept;
+	/// @brief bitmask variant of greedyMeshingFace, produces exactly the same quads
+	/// @param occupancy_masks masks built by buildOccupancyMasks
+	template<typename Descriptor>
+	GreedyMeshingPromise greedyMeshingFaceBitmask(std::span<Vertex> out, 
+			vmath::Vec3f32 chunk_position,
+			std::span<const vmath::u16> voxel_data,
+			std::span<const vmath::u64> occupancy_masks,
+			const Descriptor& desc
 	) noexcept;
 
-	~CpuMesher() noexcept { _done = true; }
+	~CpuMesher() noexcept;
 };
 
 }
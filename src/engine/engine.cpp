@@ -3,6 +3,12 @@
 using namespace vmath;
 using namespace ve001;
 
+static std::array<u64, 6> uniformSubmeshSizes(u64 submesh_size) noexcept {
+	std::array<u64, 6> submesh_sizes;
+	submesh_sizes.fill(submesh_size);
+	return submesh_sizes;
+}
+
 static bool frustumCullingUnaryOp(
 	Face orientation, 
 	Vec3f32 position,
@@ -15,25 +21,31 @@ static bool frustumCullingUnaryOp(
 ) noexcept ;
 
 
-Engine::Engine(Config config) noexcept : _engine_context(EngineContext{
+Engine::Engine(Config config) noexcept : _task_pool(this->error, config.task_pool_threads_count, config.idle_spin_count), 
+	_engine_context(EngineContext{
 		.error = this->error,
+		.task_pool = _task_pool,
 		.chunk_size = config.chunk_size,
 		.half_chunk_size = Vec3i32::divScalar(config.chunk_size, 2),
 		.chunk_size_1D = static_cast<u64>(config.chunk_size[0]) * static_cast<u64>(config.chunk_size[1]) * static_cast<u64>(config.chunk_size[2]),
 		.chunk_voxel_data_size  = static_cast<u64>(config.chunk_size[0]) * static_cast<u64>(config.chunk_size[1]) * static_cast<u64>(config.chunk_size[2]) * sizeof(u16),
 		.chunk_max_possible_submesh_indices_size = static_cast<u64>(config.chunk_size[0]) * static_cast<u64>(config.chunk_size[1]) * static_cast<u64>(config.chunk_size[2]) * sizeof(u32) * static_cast<u64>(36/6/2),
-		.chunk_max_possible_mesh_size    =  (static_cast<u64>(config.chunk_size[0]) * static_cast<u64>(config.chunk_size[1]) * static_cast<u64>(config.chunk_size[2]) * sizeof(Vertex) * static_cast<u64>(24/2)),
-		.chunk_max_possible_submesh_size = ((static_cast<u64>(config.chunk_size[0]) * static_cast<u64>(config.chunk_size[1]) * static_cast<u64>(config.chunk_size[2]) * sizeof(Vertex) * static_cast<u64>(24/2))/6),
+		.chunk_max_possible_mesh_size    =  (static_cast<u64>(config.chunk_size[0]) * static_cast<u64>(config.chunk_size[1]) * static_cast<u64>(config.chunk_size[2]) * sizeof(Vertex) * static_cast<u64>(3U * VERTICES_PER_QUAD)),
+		.chunk_max_possible_submesh_size = ((static_cast<u64>(config.chunk_size[0]) * static_cast<u64>(config.chunk_size[1]) * static_cast<u64>(config.chunk_size[2]) * sizeof(Vertex) * static_cast<u64>(3U * VERTICES_PER_QUAD))/6),
 		.chunk_max_current_mesh_size    = config.chunk_pool_growth_coefficient == 0.F ? 
-			(static_cast<u64>(config.chunk_size[0]) * static_cast<u64>(config.chunk_size[1]) * static_cast<u64>(config.chunk_size[2]) * sizeof(Vertex) * static_cast<u64>(24/2)) :
-			sizeof(Vertex) * static_cast<u64>(24),
-		.chunk_max_current_submesh_size = config.chunk_pool_growth_coefficient == 0.F ? 
-			((static_cast<u64>(config.chunk_size[0]) * static_cast<u64>(config.chunk_size[1]) * static_cast<u64>(config.chunk_size[2]) * sizeof(Vertex) * static_cast<u64>(24/2))/6) :
-			sizeof(Vertex) * static_cast<u64>(24/6),
+			(static_cast<u64>(config.chunk_size[0]) * static_cast<u64>(config.chunk_size[1]) * static_cast<u64>(config.chunk_size[2]) * sizeof(Vertex) * static_cast<u64>(3U * VERTICES_PER_QUAD)) :
+			sizeof(Vertex) * static_cast<u64>(6U * VERTICES_PER_QUAD),
+		.chunk_max_current_submesh_sizes = uniformSubmeshSizes(config.chunk_pool_growth_coefficient == 0.F ? 
+			((static_cast<u64>(config.chunk_size[0]) * static_cast<u64>(config.chunk_size[1]) * static_cast<u64>(config.chunk_size[2]) * sizeof(Vertex) * static_cast<u64>(3U * VERTICES_PER_QUAD))/6) :
+			sizeof(Vertex) * static_cast<u64>(VERTICES_PER_QUAD)),
 		.chunk_pool_growth_coefficient = config.chunk_pool_growth_coefficient,
 		.meshing_axis_progress_step = config.meshing_shader_local_group_size,
 		.use_gpu_meshing_engine = config.use_gpu_meshing_engine,
 		.cpu_mesher_threads_count = config.cpu_mesher_threads_count,
+		.cpu_mesher_slots_per_thread = config.cpu_mesher_slots_per_thread,
+		.cpu_meshing_kernel = config.cpu_meshing_kernel,
+		.max_cpu_simd_level = config.max_cpu_simd_level,
+		.idle_spin_count = config.idle_spin_count,
 		.meshing_shader_src_path = config.meshing_shader_src_path,
 		.meshing_shader_bin_path = config.meshing_shader_bin_path,
   	}),
@@ -41,6 +53,24 @@ Engine::Engine(Config config) noexcept : _engine_context(EngineContext{
 {}
 
 bool Engine::init() noexcept {
+	for (u32 axis{ 0U }; axis < 3U; ++axis) {
+		if (_engine_context.chunk_size[axis] <= 0 || _engine_context.chunk_size[axis] > MAX_CHUNK_EXTENT) {
+			error |= Error::INVALID_CHUNK_SIZE;
+		}
+	}
+#ifdef USE_VOLUME_TEXTURE_3D
+	// NOTE: volume texture meshing shader handles only 64^3 chunks
+	if (_engine_context.use_gpu_meshing_engine && (
+		_engine_context.chunk_size[0] != 64 ||
+		_engine_context.chunk_size[1] != 64 ||
+		_engine_context.chunk_size[2] != 64)) {
+		error |= Error::INVALID_CHUNK_SIZE;
+	}
+#endif
+	if (error != Error::NO_ERROR) {
+		return true;
+	}
+
     _world_grid.init();
 	return (error != Error::NO_ERROR);
 }
@@ -66,13 +96,15 @@ void Engine::applyFrustumCullingPartition(
 		y_near,
 		view_matrix
 	);
+	// NOTE: chunks which aren't yet generated and lie in the frustum are generated first
+	_world_grid._chunk_data_streamer.updateFrustumFocus(z_near, z_far, x_near, y_near, view_matrix);
 }
 
 void Engine::updateCameraPosition(Vec3f32 position) noexcept {
 	_world_grid.update(position);
 }
-bool Engine::pollChunksUpdates() noexcept {
-	return _world_grid._chunk_pool.poll();
+u32 Engine::pollChunksUpdates(u32 max_chunks_count, u64 time_budget_ns) noexcept {
+	return _world_grid._chunk_pool.poll(max_chunks_count, time_budget_ns);
 }
 void Engine::updateDrawState() noexcept {
 	_world_grid._chunk_pool.update(partitioning);
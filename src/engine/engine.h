@@ -7,6 +7,7 @@
 #include <vmath/vmath.h>
 
 #include "engine_context.h"
+#include "task_pool.h"
 #include "world_grid.h"
 #include "vertex.h"
 
@@ -20,13 +21,20 @@ struct Engine {
         vmath::Vec3f32 world_size;
         /// @brief initial camera position
         vmath::Vec3f32 initial_position;
-        /// @brief resolution in voxels of the single chunk
+        /// @brief resolution in voxels of the single chunk, each axis in [1, MAX_CHUNK_EXTENT]
         vmath::Vec3i32 chunk_size;
         /// @brief data generator called to generate data
         std::unique_ptr<ChunkGenerator> chunk_data_generator;
-        /// @brief configures number of threads used by ChunkDataStreamer
-        /// if 0 then the number of threads will that of the number of CPU threads
+        /// @brief max number of task pool's workers generating chunks at once (ChunkDataStreamer),
+        /// if 0 then all of the workers can be used
         vmath::u32 chunk_data_streamer_threads_count;
+        /// @brief engine's thread budget - number of worker threads of the task pool which
+        /// executes all of the background work (generation, meshing, upload preparation), 
+        /// if 0 then the number of threads will be that of the number of CPU threads
+        vmath::u32 task_pool_threads_count{ 0U };
+        /// @brief number of spins of waiting engine's threads before they park (block until
+        /// they are woken up), 0 means that threads park right away
+        vmath::u32 idle_spin_count{ 4096U };
         /// @brief growth coefficient of the pool. Value of overflow is multiplied
         /// by this coefficient deciding new max size of the chunk pool
         vmath::f32 chunk_pool_growth_coefficient;
@@ -35,18 +43,44 @@ struct Engine {
         vmath::i32 meshing_shader_local_group_size{ 64 };
 		/// @brief if to use GPU based meshing engine
 		bool use_gpu_meshing_engine;
-		/// @brief if to use GPU based meshing engine
+		/// @brief max number of task pool's workers meshing chunks at once, 0 means all
+		/// of the workers (ignored if GPU based meshing engine is used)
 		vmath::i32 cpu_mesher_threads_count;
+		/// @brief number of cpu mesher's slots per meshing thread. Slot holds its mesh until
+		/// the copy to the gpu is finished, so more slots keep more uploads in flight
+		/// (ignored if GPU based meshing engine is used)
+		vmath::u32 cpu_mesher_slots_per_thread{ 2U };
+		/// @brief kernel used by cpu mesher (ignored if GPU based meshing engine is used)
+		CpuMeshingKernel cpu_meshing_kernel{ CPU_MESHING_KERNEL_NAIVE };
+		/// @brief best instruction set used by cpu mesher, the best one supported by the cpu
+		/// is picked at runtime up to this level (ignored if GPU based meshing engine is used)
+		CpuSimdLevel max_cpu_simd_level{ CPU_SIMD_LEVEL_AVX2 };
 #ifdef USE_VOLUME_TEXTURE_3D
 		/// @brief path to meshing shader src
 		std::filesystem::path meshing_shader_src_path{"./shaders/src/greedy_meshing_shader/optshader.comp"};
+#if defined(USE_VERTEX_PULLING)
+		/// @brief path to meshing shader bin in spirv (optional)        
+		std::optional<std::filesystem::path> meshing_shader_bin_path{"./shaders/bin/greedy_meshing_shader/pulling_optcomp.spv"};
+#elif defined(USE_PACKED_VERTEX)
+		/// @brief path to meshing shader bin in spirv (optional)        
+		std::optional<std::filesystem::path> meshing_shader_bin_path{"./shaders/bin/greedy_meshing_shader/packed_optcomp.spv"};
+#else
 		/// @brief path to meshing shader bin in spirv (optional)        
 		std::optional<std::filesystem::path> meshing_shader_bin_path{"./shaders/bin/greedy_meshing_shader/optcomp.spv"};
+#endif
 #else
 		/// @brief path to meshing shader src
 		std::filesystem::path meshing_shader_src_path{"./shaders/src/greedy_meshing_shader/shader.comp"};
+#if defined(USE_VERTEX_PULLING)
+		/// @brief path to meshing shader bin in spirv (optional)        
+		std::optional<std::filesystem::path> meshing_shader_bin_path{"./shaders/bin/greedy_meshing_shader/pulling_comp.spv"};
+#elif defined(USE_PACKED_VERTEX)
+		/// @brief path to meshing shader bin in spirv (optional)        
+		std::optional<std::filesystem::path> meshing_shader_bin_path{"./shaders/bin/greedy_meshing_shader/packed_comp.spv"};
+#else
 		/// @brief path to meshing shader bin in spirv (optional)        
 		std::optional<std::filesystem::path> meshing_shader_bin_path{"./shaders/bin/greedy_meshing_shader/comp.spv"};
+#endif
 #endif
     };
 
@@ -55,6 +89,8 @@ struct Engine {
 
     /// @brief if true partitioning is used based on applied partitions
     bool partitioning{ false };
+    /// @brief task pool shared by engine's modules
+    TaskPool _task_pool;
     /// @brief engine context containing common metadata for modules
     EngineContext _engine_context;
     /// @brief world grid holding chunk pool and managing 
@@ -65,7 +101,8 @@ struct Engine {
     /// @param config confiugration structure 
     Engine(Config config) noexcept;
 
-    /// @brief applies frustum culling based on separating axis theorem
+    /// @brief applies frustum culling based on separating axis theorem, frustum
+    /// is also used to prioritize generation of visible chunks
     /// @param use_last_partition wether to use last partitioning
     /// @param z_near near plane
     /// @param z_far far plane
@@ -99,9 +136,13 @@ struct Engine {
     /// @brief updates world grid state based on camera position
     /// @param position new camera position
     void updateCameraPosition(vmath::Vec3f32 position) noexcept;
-    /// @brief polls for chunks updates (non blocking!)
-    /// @return true if new chunk was loaded
-    bool pollChunksUpdates() noexcept;
+    /// @brief polls for chunks updates (non blocking!), completes meshed chunks until
+    /// either of the limits is reached or no more chunks are ready
+    /// @param max_chunks_count max number of chunks loaded by the call, 0 means no limit
+    /// @param time_budget_ns time spent on loading chunks after which the call returns
+    /// (checked after each chunk), 0 means no limit
+    /// @return number of loaded chunks
+    vmath::u32 pollChunksUpdates(vmath::u32 max_chunks_count = 1U, vmath::u64 time_budget_ns = 0UL) noexcept;
     /// @brief updates draw state, binds vao, vbo. If draw command buffer is dirty
     /// supplies draw commands to gpu
     void updateDrawState() noexcept;
@@ -1,6 +1,7 @@
 #ifndef VE001_ENGINE_CONTEXT_H
 #define VE001_ENGINE_CONTEXT_H
 
+#include <array>
 #include <optional>
 #include <filesystem>
 
@@ -10,10 +11,22 @@
 
 namespace ve001 {
 
+struct TaskPool;
+
+#if defined(USE_PACKED_VERTEX) || defined(USE_VERTEX_PULLING)
+/// @brief max extent of a chunk along any axis, packed vertex positions are 7-bit
+inline constexpr vmath::i32 MAX_CHUNK_EXTENT{ 64 };
+#else
+/// @brief max extent of a chunk along any axis
+inline constexpr vmath::i32 MAX_CHUNK_EXTENT{ 256 };
+#endif
+
 /// @brief context holds common state for different engine components/modules
 struct EngineContext {
     /// @brief errors
     Error& error;
+    /// @brief task pool shared by engine components for fork-join work
+    TaskPool& task_pool;
     /// @brief chunk size/resolution 
     vmath::Vec3i32 chunk_size;
     /// @brief half chunk size/resolution 
@@ -22,24 +35,35 @@ struct EngineContext {
     vmath::u64 chunk_size_1D;
     /// @brief chunk size in voxel context (single voxel chunk)
     vmath::u64 chunk_voxel_data_size;
-    /// @brief maximum possible mesh size of a single chunk's side's indices after greedy meshing
+    /// @brief maximum possible mesh size of a single chunk's side's indices after greedy meshing,
+    /// upper bound of the shared ibo which grows with current submesh limits
     vmath::u64 chunk_max_possible_submesh_indices_size;
     /// @brief maximum possible mesh size of a single chunk after greedy meshing
     vmath::u64 chunk_max_possible_mesh_size;
     /// @brief maximum possible mesh size of a single chunk's side after greedy meshing
     vmath::u64 chunk_max_possible_submesh_size;
     /// @brief maximum current mesh size of a single chunk after greedy meshing
+    /// (sum of <chunk_max_current_submesh_sizes>)
     vmath::u64 chunk_max_current_mesh_size;
-    /// @brief maximum current mesh size of a single chunk's side after greedy meshing
-    vmath::u64 chunk_max_current_submesh_size;
+    /// @brief maximum current mesh size of each chunk's side (indexed by Face) after
+    /// greedy meshing, sides grow and shrink independently
+    std::array<vmath::u64, 6> chunk_max_current_submesh_sizes;
     /// @brief chunk pool memory growth coefficient
     vmath::f32 chunk_pool_growth_coefficient;
     /// @brief it maps to local_size_x attribute in greedy meshing compute shader
     vmath::i32 meshing_axis_progress_step{ 64 };
 	/// @brief if to use GPU based meshing engine
 	bool use_gpu_meshing_engine;
-	/// @brief if to use GPU based meshing engine
+	/// @brief max number of task pool's workers meshing chunks at once, 0 means all of the workers
 	vmath::i32 cpu_mesher_threads_count;
+	/// @brief number of cpu mesher's slots (and upload slots) per meshing thread
+	vmath::u32 cpu_mesher_slots_per_thread{ 2U };
+	/// @brief kernel used by cpu mesher to mesh a chunk
+	CpuMeshingKernel cpu_meshing_kernel{ CPU_MESHING_KERNEL_NAIVE };
+	/// @brief best instruction set cpu mesher may use, capped by the cpu
+	CpuSimdLevel max_cpu_simd_level{ CPU_SIMD_LEVEL_AVX2 };
+	/// @brief number of spins of waiting threads before they park
+	vmath::u32 idle_spin_count{ 4096U };
     /// @brief path to meshing shader src
     std::filesystem::path meshing_shader_src_path;
     /// @brief path to meshing shader bin in spirv (optional)        
@@ -11,6 +11,34 @@ enum Face : vmath::u32 {
     Z_POS, Z_NEG
 };
 
+enum CpuMeshingKernel : vmath::u32 {
+    /// @brief per voxel visibility test and quad merging
+    CPU_MESHING_KERNEL_NAIVE,
+    /// @brief 64-bit occupancy masks, visibility with shift/and-not,
+    /// quad merging with count trailing zeros scans
+    CPU_MESHING_KERNEL_BITMASK
+};
+
+enum CpuSimdLevel : vmath::u32 {
+    /// @brief portable word at a time loops
+    CPU_SIMD_LEVEL_SCALAR,
+    /// @brief 8 voxels per compare
+    CPU_SIMD_LEVEL_SSE4_1,
+    /// @brief 16 voxels per compare
+    CPU_SIMD_LEVEL_AVX2
+};
+
+/// @brief lanes of engine's task pool, lower value means higher priority
+enum TaskLane : vmath::u32 {
+    /// @brief work preparing finished meshes for upload
+    TASK_LANE_UPLOAD_PREPARATION,
+    /// @brief meshing of chunks
+    TASK_LANE_MESHING,
+    /// @brief generation of chunks' voxel data
+    TASK_LANE_GENERATION,
+    TASK_LANES_COUNT
+};
+
 enum Error : vmath::u32 {
     NO_ERROR = 0x0U,
     GPU_ALLOCATION_FAILED = 0x01U,
@@ -21,6 +49,8 @@ enum Error : vmath::u32 {
     CHUNK_DATA_STREAMER_THREAD_ALLOCATION_FAILED = 0x20U,
     CHUNK_DATA_STREAMER_THREAD_INITIALIZATION_FAILED = 0x40U,
     CPU_MESHING_ENGINE_THREAD_ALLOCATION_FAILED = 0x80U,
+    TASK_POOL_THREAD_ALLOCATION_FAILED = 0x100U,
+    INVALID_CHUNK_SIZE = 0x200U,
 };
 
 inline Error operator|(Error lhs, Error rhs) {
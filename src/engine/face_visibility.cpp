@@ -0,0 +1,190 @@
+#include "face_visibility.h"
+
+#include <algorithm>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define VE001_FACE_VISIBILITY_X86
+#include <immintrin.h>
+#endif
+
+using namespace ve001;
+using namespace vmath;
+
+static constexpr i64 VOXELS_PER_WORD{ 64 };
+
+/// @brief single word of the pass, handles partial words and neighbours outside of the data
+static u64 scalarWord(std::span<const u16> voxel_data, i64 neighbour_offset, i64 word) noexcept {
+    const auto size = static_cast<i64>(voxel_data.size());
+    const auto begin = word * VOXELS_PER_WORD;
+    const auto end = std::min(begin + VOXELS_PER_WORD, size);
+
+    u64 bits{ 0UL };
+    for (i64 i{ begin }; i < end; ++i) {
+        const auto neighbour = i + neighbour_offset;
+        const bool neighbour_empty = neighbour < 0 || neighbour >= size || voxel_data[neighbour] == 0;
+        bits |= static_cast<u64>(voxel_data[i] != 0 && neighbour_empty) << (i - begin);
+    }
+    return bits;
+}
+
+/// @brief range of words whose voxels and neighbours are all inside of the data,
+/// the rest goes through scalarWord
+static void fullWords(i64 size, i64 neighbour_offset, i64& first, i64& last) noexcept {
+    const auto low = std::max(-neighbour_offset, i64{ 0 });
+    const auto high = size - VOXELS_PER_WORD - std::max(neighbour_offset, i64{ 0 });
+    first = (low + VOXELS_PER_WORD - 1) / VOXELS_PER_WORD;
+    last = high < 0 ? -1 : high / VOXELS_PER_WORD;
+}
+
+static void faceVisibilityScalar(std::span<u64> out, std::span<const u16> voxel_data, i64 neighbour_offset) noexcept {
+    const auto size = static_cast<i64>(voxel_data.size());
+    const auto words = (size + VOXELS_PER_WORD - 1) / VOXELS_PER_WORD;
+    i64 first{ 0 };
+    i64 last{ 0 };
+    fullWords(size, neighbour_offset, first, last);
+
+    const u16* data = voxel_data.data();
+    for (i64 word{ 0 }; word < words; ++word) {
+        if (word < first || word > last) {
+            out[word] = scalarWord(voxel_data, neighbour_offset, word);
+            continue;
+        }
+        const u16* voxels = data + word * VOXELS_PER_WORD;
+        const u16* neighbours = voxels + neighbour_offset;
+        u64 bits{ 0UL };
+        for (i64 i{ 0 }; i < VOXELS_PER_WORD; ++i) {
+            bits |= static_cast<u64>((voxels[i] != 0) & (neighbours[i] == 0)) << i;
+        }
+        out[word] = bits;
+    }
+}
+
+#ifdef VE001_FACE_VISIBILITY_X86
+
+__attribute__((target("sse4.1")))
+static u32 visibleBitsSse(const u16* voxels, const u16* neighbours) noexcept {
+    const auto zero = _mm_setzero_si128();
+    const auto voxels_0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(voxels));
+    const auto voxels_1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(voxels + 8));
+    const auto neighbours_0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(neighbours));
+    const auto neighbours_1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(neighbours + 8));
+    // NOTE: lanes are 0xFFFF where voxel is solid and neighbour is empty
+    const auto visible_0 = _mm_andnot_si128(_mm_cmpeq_epi16(voxels_0, zero), _mm_cmpeq_epi16(neighbours_0, zero));
+    const auto visible_1 = _mm_andnot_si128(_mm_cmpeq_epi16(voxels_1, zero), _mm_cmpeq_epi16(neighbours_1, zero));
+    return static_cast<u32>(_mm_movemask_epi8(_mm_packs_epi16(visible_0, visible_1)));
+}
+
+__attribute__((target("sse4.1")))
+static void faceVisibilitySse(std::span<u64> out, std::span<const u16> voxel_data, i64 neighbour_offset) noexcept {
+    const auto size = static_cast<i64>(voxel_data.size());
+    const auto words = (size + VOXELS_PER_WORD - 1) / VOXELS_PER_WORD;
+    i64 first{ 0 };
+    i64 last{ 0 };
+    fullWords(size, neighbour_offset, first, last);
+
+    const u16* data = voxel_data.data();
+    for (i64 word{ 0 }; word < words; ++word) {
+        if (word < first || word > last) {
+            out[word] = scalarWord(voxel_data, neighbour_offset, word);
+            continue;
+        }
+        const u16* voxels = data + word * VOXELS_PER_WORD;
+        const auto any_solid = _mm_or_si128(
+            _mm_or_si128(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(voxels)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(voxels + 8))),
+            _mm_or_si128(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(voxels + 16)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(voxels + 24))));
+        const auto any_solid_hi = _mm_or_si128(
+            _mm_or_si128(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(voxels + 32)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(voxels + 40))),
+            _mm_or_si128(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(voxels + 48)),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(voxels + 56))));
+        // NOTE: air is the most common case, neighbours aren't loaded for it
+        const auto solid = _mm_or_si128(any_solid, any_solid_hi);
+        if (_mm_testz_si128(solid, solid)) {
+            out[word] = 0UL;
+            continue;
+        }
+        const u16* neighbours = voxels + neighbour_offset;
+        out[word] =
+            static_cast<u64>(visibleBitsSse(voxels, neighbours)) |
+            static_cast<u64>(visibleBitsSse(voxels + 16, neighbours + 16)) << 16U |
+            static_cast<u64>(visibleBitsSse(voxels + 32, neighbours + 32)) << 32U |
+            static_cast<u64>(visibleBitsSse(voxels + 48, neighbours + 48)) << 48U;
+    }
+}
+
+__attribute__((target("avx2")))
+static u32 visibleBitsAvx2(const u16* voxels, const u16* neighbours) noexcept {
+    const auto zero = _mm256_setzero_si256();
+    const auto voxels_0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(voxels));
+    const auto voxels_1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(voxels + 16));
+    const auto neighbours_0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(neighbours));
+    const auto neighbours_1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(neighbours + 16));
+    const auto visible_0 = _mm256_andnot_si256(_mm256_cmpeq_epi16(voxels_0, zero), _mm256_cmpeq_epi16(neighbours_0, zero));
+    const auto visible_1 = _mm256_andnot_si256(_mm256_cmpeq_epi16(voxels_1, zero), _mm256_cmpeq_epi16(neighbours_1, zero));
+    // NOTE: packing interleaves 128-bit lanes, permutation restores order of voxels
+    const auto packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(visible_0, visible_1), 0xD8);
+    return static_cast<u32>(_mm256_movemask_epi8(packed));
+}
+
+__attribute__((target("avx2")))
+static void faceVisibilityAvx2(std::span<u64> out, std::span<const u16> voxel_data, i64 neighbour_offset) noexcept {
+    const auto size = static_cast<i64>(voxel_data.size());
+    const auto words = (size + VOXELS_PER_WORD - 1) / VOXELS_PER_WORD;
+    i64 first{ 0 };
+    i64 last{ 0 };
+    fullWords(size, neighbour_offset, first, last);
+
+    const u16* data = voxel_data.data();
+    for (i64 word{ 0 }; word < words; ++word) {
+        if (word < first || word > last) {
+            out[word] = scalarWord(voxel_data, neighbour_offset, word);
+            continue;
+        }
+        const u16* voxels = data + word * VOXELS_PER_WORD;
+        const auto solid = _mm256_or_si256(
+            _mm256_or_si256(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(voxels)),
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(voxels + 16))),
+            _mm256_or_si256(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(voxels + 32)),
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(voxels + 48))));
+        if (_mm256_testz_si256(solid, solid)) {
+            out[word] = 0UL;
+            continue;
+        }
+        const u16* neighbours = voxels + neighbour_offset;
+        out[word] =
+            static_cast<u64>(visibleBitsAvx2(voxels, neighbours)) |
+            static_cast<u64>(visibleBitsAvx2(voxels + 32, neighbours + 32)) << 32U;
+    }
+}
+
+#endif
+
+CpuSimdLevel ve001::supportedCpuSimdLevel() noexcept {
+#ifdef VE001_FACE_VISIBILITY_X86
+    if (__builtin_cpu_supports("avx2")) {
+        return CPU_SIMD_LEVEL_AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return CPU_SIMD_LEVEL_SSE4_1;
+    }
+#endif
+    return CPU_SIMD_LEVEL_SCALAR;
+}
+
+FaceVisibilityKernel ve001::selectFaceVisibilityKernel(CpuSimdLevel max_level) noexcept {
+    switch (std::min(max_level, supportedCpuSimdLevel())) {
+#ifdef VE001_FACE_VISIBILITY_X86
+        case CPU_SIMD_LEVEL_AVX2: return faceVisibilityAvx2;
+        case CPU_SIMD_LEVEL_SSE4_1: return faceVisibilitySse;
+#endif
+        default: return faceVisibilityScalar;
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef VE001_FACE_VISIBILITY_H
+#define VE001_FACE_VISIBILITY_H
+
+#include <span>
+
+#include <vmath/vmath.h>
+
+#include "enums.h"
+
+namespace ve001 {
+
+/// @brief visibility pass of a single face over whole voxel data. Bit i of <out> is set if
+/// voxel i is solid and voxel i + <neighbour_offset> is empty, neighbours outside of
+/// <voxel_data> count as empty. Voxel data is treated as flat array so neighbours which
+/// wrap around a row or a plane have to be fixed up by the caller
+/// @param out at least ceil(voxel_data.size()/64) words
+using FaceVisibilityKernel = void (*)(std::span<vmath::u64> out,
+    std::span<const vmath::u16> voxel_data, vmath::i64 neighbour_offset) noexcept;
+
+/// @return the best instruction set supported by the cpu
+CpuSimdLevel supportedCpuSimdLevel() noexcept;
+/// @brief picks implementation of the pass for the cpu, never above <max_level>
+FaceVisibilityKernel selectFaceVisibilityKernel(CpuSimdLevel max_level) noexcept;
+
+}
+
+#endif
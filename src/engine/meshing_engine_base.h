@@ -40,6 +40,10 @@ struct MeshingEngineBase {
         /// @brief if true then number of potentially written vertices is
         /// bigger than current chunk region size and pool needs to be extended
         bool overflow_flag{ false };
+        /// @brief if true then mesh didn't fit current limits but it was meshed into
+        /// a bigger temporary buffer and is valid. Limits should grow, but the chunk
+        /// doesn't have to be meshed again
+        bool spilled{ false };
     };
 
     const EngineContext& _engine_context;
@@ -54,16 +58,40 @@ struct MeshingEngineBase {
     /// @param voxel_data pointer to voxel_data based on which the meshing will take place
     virtual void issueMeshingCommand(ChunkId chunk_id, vmath::Vec3f32 chunk_position, std::span<const vmath::u16> voxel_data) noexcept = 0;
 
+    /// @brief cancels pending meshing command of the chunk (eg. chunk was deallocated), its
+    /// result is never returned by pollMeshingCommand. By default commands can't be cancelled
+    /// @param chunk_id id of the chunk
+    virtual void cancelMeshingCommand([[maybe_unused]] ChunkId chunk_id) noexcept {}
+
     /// @brief Function polls for the result from next command. It isn't waiting (the call
     // is non blocking), only checks once.
     /// @param result variable to which the function write result into
     /// @return true if valid value was written into the <future> param false if not
     virtual bool pollMeshingCommand(Result& result) noexcept = 0;
 
+    /// @brief copies mesh of the result returned by the last pollMeshingCommand call into
+    /// the vbo. Submeshes are packed one after another (in ve001::Face order) without gaps,
+    /// so the destination range has to fit exactly the written vertices. Has to be called
+    /// before any other call to the engine, otherwise the mesh may be already overwritten.
+    /// Engine may defer the copy until flushUploads is called
+    /// @param result result of the last pollMeshingCommand call (without overflow)
+    /// @param dst_offset offset in bytes in the vbo at which to place the mesh
+    virtual void uploadMesh(const Result& result, vmath::u64 dst_offset) noexcept = 0;
+
+    /// @brief issues deferred copies of meshes passed to uploadMesh since the last flush.
+    /// Has to be called before the vbo's content is moved or the vbo is replaced. By
+    /// default meshes are copied right away by uploadMesh
+    virtual void flushUploads() noexcept {}
+
     /// @brief updates metadata based on engine context and new vbo id
     /// @param new_vbo_id new vbo id to which to write meshes
     virtual void updateMetadata(vmath::u32 new_vbo_id) noexcept = 0;
 
+    /// @brief changes vbo to which meshes are uploaded, limits stay the same
+    /// so pending commands aren't affected
+    /// @param new_vbo_id new vbo id to which to write meshes
+    virtual void updateVbo(vmath::u32 new_vbo_id) noexcept = 0;
+
 #ifdef ENGINE_TEST
 	virtual std::tuple<vmath::u64, vmath::u64, vmath::u64>
 		getBenchmarkData() const noexcept = 0;
@@ -3,16 +3,26 @@
 #include <glad/glad.h>
 
 #include <cstring>
+#include <algorithm>
 
 
 using namespace ve001;
 using namespace vmath;
 
 MeshingEngineCPU::MeshingEngineCPU(const EngineContext& engine_context, vmath::u32 max_chunks, vmath::u32 threads_count) noexcept : MeshingEngineBase(engine_context), _cpu_mesher(engine_context, threads_count, max_chunks) {
-	while(!_cpu_mesher.ready()) {}
-
     try {
         _commands.resize(max_chunks);
+        _chunk_id_to_handle.resize(max_chunks, CpuMesher::Results::INVALID_HANDLE);
+        _chunk_id_to_deferral.resize(max_chunks, 0U);
+        // NOTE: chunk has at most one live deferred command, the rest is room
+        // for cancelled ones which are compacted once the ring is full
+        _deferred_commands.resize(std::max(static_cast<std::size_t>(max_chunks) * 2UL, std::size_t{ 1UL }));
+        _upload_slots.resize(_cpu_mesher._slots.size());
+        // NOTE: slot is in flight at most once and each batch has at least
+        // one slot, the rings never fill up
+        _uploading_slots.resize(std::max(_cpu_mesher._slots.size(), std::size_t{ 1UL }));
+        _uploading_batches.resize(std::max(_cpu_mesher._slots.size(), std::size_t{ 1UL }));
+        _batch_copies.reserve(_cpu_mesher._slots.size() * 6UL);
     } catch(const std::exception&) {
         _engine_context.error |= Error::CPU_ALLOCATION_FAILED;
     }
@@ -21,83 +31,255 @@ MeshingEngineCPU::MeshingEngineCPU(const EngineContext& engine_context, vmath::u
 void MeshingEngineCPU::init(vmath::u32 vbo_id) noexcept {
 	_vbo_id = vbo_id;
 
-    glCreateBuffers(1, &_staging_buffer_id);
-    glNamedBufferStorage(
-        _staging_buffer_id,
-        _engine_context.chunk_max_current_mesh_size,
-        nullptr,
-        GL_MAP_WRITE_BIT|GL_MAP_PERSISTENT_BIT|GL_MAP_COHERENT_BIT
-    );
-
-    if (glGetError() == GL_OUT_OF_MEMORY) {
-        _engine_context.error |= Error::GPU_ALLOCATION_FAILED;
-        return;
-    }
+	for (std::size_t i{ 0UL }; i < _upload_slots.size(); ++i) {
+		initUploadSlot(i, _engine_context.chunk_max_current_mesh_size);
+	}
+}
 
-    _staging_buffer_ptr = glMapNamedBufferRange(
-        _staging_buffer_id,
-        0U,
-        _engine_context.chunk_max_current_mesh_size,
-        GL_MAP_WRITE_BIT|GL_MAP_PERSISTENT_BIT|GL_MAP_COHERENT_BIT
-    );
-
-    if (_staging_buffer_ptr == nullptr) {
-        glDeleteBuffers(1, &_staging_buffer_id);
-        _engine_context.error |= Error::GPU_BUFFER_MAPPING_FAILED;
-        return;
-    }
+void MeshingEngineCPU::initUploadSlot(std::size_t slot_index, vmath::u64 size) noexcept {
+	auto& slot = _upload_slots[slot_index];
+	if (slot.buffer_id != 0U) {
+		deinitUploadSlot(slot_index);
+	}
+	// NOTE: jobs of slot without buffer mesh into cpu memory
+	_cpu_mesher.setUploadBuffer(slot_index, {});
+
+	glCreateBuffers(1, &slot.buffer_id);
+	glNamedBufferStorage(
+		slot.buffer_id,
+		static_cast<i64>(size),
+		nullptr,
+		GL_MAP_WRITE_BIT|GL_MAP_PERSISTENT_BIT|GL_MAP_COHERENT_BIT
+	);
+
+	if (glGetError() == GL_OUT_OF_MEMORY) {
+		glDeleteBuffers(1, &slot.buffer_id);
+		slot.buffer_id = 0U;
+		_engine_context.error |= Error::GPU_ALLOCATION_FAILED;
+		return;
+	}
+
+	slot.ptr = glMapNamedBufferRange(
+		slot.buffer_id,
+		0U,
+		static_cast<i64>(size),
+		GL_MAP_WRITE_BIT|GL_MAP_PERSISTENT_BIT|GL_MAP_COHERENT_BIT
+	);
+
+	if (slot.ptr == nullptr) {
+		glDeleteBuffers(1, &slot.buffer_id);
+		slot.buffer_id = 0U;
+		_engine_context.error |= Error::GPU_BUFFER_MAPPING_FAILED;
+		return;
+	}
+	slot.size = size;
+	_cpu_mesher.setUploadBuffer(slot_index, std::span<Vertex>(static_cast<Vertex*>(slot.ptr), size/sizeof(Vertex)));
+}
+
+void MeshingEngineCPU::deinitUploadSlot(std::size_t slot_index) noexcept {
+	auto& slot = _upload_slots[slot_index];
+	glUnmapNamedBuffer(slot.buffer_id);
+	glDeleteBuffers(1, &slot.buffer_id);
+	slot = UploadSlot{};
+}
+
+void MeshingEngineCPU::releaseUploadSlot(std::size_t slot_index) noexcept {
+	// NOTE: limits changed since the buffer was created, it's safe to recreate it
+	// since neither the mesher nor the gpu uses it
+	const auto mesh_size = _engine_context.chunk_max_current_mesh_size;
+	const auto& slot = _upload_slots[slot_index];
+	if (slot.size < mesh_size || slot.size > mesh_size * 2UL) {
+		initUploadSlot(slot_index, mesh_size);
+	}
+	_cpu_mesher.releaseStagingBuffer(&_cpu_mesher._slots[slot_index].in_use);
+}
+
+void MeshingEngineCPU::releaseUploadedSlots() noexcept {
+	// NOTE: fences are signaled in order of their insertion, batches behind
+	// the first pending one can't be finished either
+	UploadBatch batch{};
+	while (_uploading_batches.peek(batch)) {
+		const auto wait_result = glClientWaitSync(static_cast<GLsync>(batch.fence), 0, 0);
+		if (wait_result == GL_TIMEOUT_EXPIRED) {
+			return;
+		}
+		if (wait_result == GL_WAIT_FAILED) {
+			_engine_context.error |= Error::FENCE_WAIT_FAILED;
+		}
+		glDeleteSync(static_cast<GLsync>(batch.fence));
+		_uploading_batches.emptyRead();
+		for (std::size_t i{ 0UL }; i < batch.slots_count; ++i) {
+			std::size_t slot_index{ 0UL };
+			_uploading_slots.read(slot_index);
+			releaseUploadSlot(slot_index);
+		}
+	}
 }
 
 void MeshingEngineCPU::issueMeshingCommand(ChunkId chunk_id, vmath::Vec3f32 chunk_position, std::span<const vmath::u16> voxel_data) noexcept {
-	_commands.write(chunk_id, _cpu_mesher.mesh(chunk_position, voxel_data));
+	++_pending_commands_count;
+	// NOTE: commands are issued in order, later command mustn't overtake the deferred ones
+	if (!_deferred_commands.empty()) {
+		deferMeshingCommand(chunk_id, chunk_position, voxel_data);
+		return;
+	}
+	// NOTE: fails if result slots are taken by cancelled results which weren't polled yet
+	const auto handle = _cpu_mesher.mesh(chunk_position, voxel_data);
+	if (handle == CpuMesher::Results::INVALID_HANDLE) {
+		deferMeshingCommand(chunk_id, chunk_position, voxel_data);
+		return;
+	}
+	_chunk_id_to_handle[chunk_id] = handle;
+	_commands[handle] = CommandCPU{ chunk_id };
+}
+
+void MeshingEngineCPU::deferMeshingCommand(ChunkId chunk_id, vmath::Vec3f32 chunk_position, std::span<const vmath::u16> voxel_data) noexcept {
+	const auto deferral = ++_chunk_id_to_deferral[chunk_id];
+	_chunk_id_to_handle[chunk_id] = DEFERRED_HANDLE;
+
+	const DeferredCommandCPU cmd{
+		.chunk_id = chunk_id,
+		.chunk_position = chunk_position,
+		.voxel_data = voxel_data,
+		.deferral = deferral
+	};
+	if (_deferred_commands.write(cmd)) {
+		return;
+	}
+	// NOTE: ring is full of cancelled commands, there is at most one live command per chunk
+	// so after dropping them there is always room
+	const auto count = _deferred_commands._buffer.size();
+	for (std::size_t i{ 0UL }; i < count; ++i) {
+		DeferredCommandCPU deferred_cmd{};
+		_deferred_commands.read(deferred_cmd);
+		if (_chunk_id_to_handle[deferred_cmd.chunk_id] == DEFERRED_HANDLE &&
+			_chunk_id_to_deferral[deferred_cmd.chunk_id] == deferred_cmd.deferral) {
+			_deferred_commands.write(deferred_cmd);
+		} else {
+			--_pending_commands_count;
+		}
+	}
+	_deferred_commands.write(cmd);
+}
+
+void MeshingEngineCPU::issueDeferredCommands() noexcept {
+	DeferredCommandCPU cmd{};
+	while (_deferred_commands.peek(cmd)) {
+		if (_chunk_id_to_handle[cmd.chunk_id] != DEFERRED_HANDLE ||
+			_chunk_id_to_deferral[cmd.chunk_id] != cmd.deferral) {
+			_deferred_commands.emptyRead();
+			--_pending_commands_count;
+			continue;
+		}
+		const auto handle = _cpu_mesher.mesh(cmd.chunk_position, cmd.voxel_data);
+		if (handle == CpuMesher::Results::INVALID_HANDLE) {
+			return;
+		}
+		_deferred_commands.emptyRead();
+		_chunk_id_to_handle[cmd.chunk_id] = handle;
+		_commands[handle] = CommandCPU{ cmd.chunk_id };
+	}
+}
+
+void MeshingEngineCPU::cancelMeshingCommand(ChunkId chunk_id) noexcept {
+	if (auto& handle = _chunk_id_to_handle[chunk_id]; handle != CpuMesher::Results::INVALID_HANDLE) {
+		// NOTE: deferred command is dropped once it reaches the front of the queue
+		if (handle != DEFERRED_HANDLE) {
+			_cpu_mesher._results.cancel(handle);
+		}
+		handle = CpuMesher::Results::INVALID_HANDLE;
+	}
 }
 
 bool MeshingEngineCPU::pollMeshingCommand(Result& result) noexcept {
-	CommandCPU* cmd;
-	if (!_commands.peek(cmd))
-		return false;
-	
-	if (cmd->future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
-		return false;
+	// NOTE: previous result wasn't uploaded (eg. chunk was deallocated or mesh is empty)
+	if (_polled_slot != INVALID_SLOT) {
+		releaseUploadSlot(_polled_slot);
+		_polled_slot = INVALID_SLOT;
+	}
+
+	// NOTE: copies of previous results don't hold the next one, only their
+	// slots are kept until the copies are finished
+	releaseUploadedSlots();
+	// NOTE: result slots taken by the previous call are free now
+	issueDeferredCommands();
 
-	_commands.emptyRead();
+	// NOTE: command which completed first is consumed first, so a slow
+	// chunk doesn't block those which finished after it. Cancelled results
+	// are dropped until a live one is found, false means nothing is ready
+	CpuMesher::Handle handle{ CpuMesher::Results::INVALID_HANDLE };
+	CommandCPU cmd{};
+	CpuMesher::Promise value{};
+	for (;;) {
+		if (!_cpu_mesher._results.pollReady(handle))
+			return false;
 
-	auto value = cmd->future.get();
+		--_pending_commands_count;
+		cmd = _commands[handle];
 
-	result.chunk_id = cmd->chunk_id;
+		// NOTE: chunk id of cancelled command may be already reused by other chunk
+		const bool cancelled = _cpu_mesher._results.cancelled(handle);
+		value = _cpu_mesher._results.get(handle);
+		if (!cancelled) {
+			_chunk_id_to_handle[cmd.chunk_id] = CpuMesher::Results::INVALID_HANDLE;
+			break;
+		}
+		if (value.staging_buffer_in_use_flag != nullptr) {
+			releaseUploadSlot(value.slot_index);
+		}
+	}
+
+	result.chunk_id = cmd.chunk_id;
     result.written_indices[X_POS] = value.written_quads[X_POS] * 6U;
     result.written_indices[X_NEG] = value.written_quads[X_NEG] * 6U;
     result.written_indices[Y_POS] = value.written_quads[Y_POS] * 6U;
     result.written_indices[Y_NEG] = value.written_quads[Y_NEG] * 6U;
     result.written_indices[Z_POS] = value.written_quads[Z_POS] * 6U;
     result.written_indices[Z_NEG] = value.written_quads[Z_NEG] * 6U;
-	result.overflow_flag = value.overflow_flag;
-
-	if (!result.overflow_flag) {
-		if (_fence != nullptr) {
-			const auto wait_result = glClientWaitSync(static_cast<GLsync>(_fence), 0, 0);
-			if (wait_result == GL_WAIT_FAILED) {
-				_engine_context.error |= Error::FENCE_WAIT_FAILED;
-				_fence = nullptr;
-				return false;
-			}
-			if (wait_result == GL_TIMEOUT_EXPIRED) {
-				_fence = nullptr;
-				return false;
-			}
-    		glDeleteSync(static_cast<GLsync>(_fence));
+	// NOTE: mesher never overflows, chunk which doesn't fit the limits is spilled
+	result.overflow_flag = false;
+	result.spilled = value.spilled;
+
+	// NOTE: mesh is uploaded straight from the slot, it's held until the copy is finished
+	if (value.in_upload_buffer) {
+		_polled_slot = value.slot_index;
+		_polled_submesh_offsets = value.submesh_offsets;
+#ifdef ENGINE_TEST
+		value.cmd_timer_real.stop();
+		result_meshing_time_ns = value.cmd_timer_meshing.duration;
+		result_real_meshing_time_ns = value.cmd_timer_real.duration;
+#endif
+		return true;
+	}
+
+	u64 mesh_size{ 0UL };
+	for (const auto written_quads : value.written_quads) {
+		mesh_size += static_cast<u64>(written_quads) * VERTICES_PER_QUAD * sizeof(Vertex);
+	}
+	// NOTE: mesh is in cpu memory (spilled or limits grew past the slot), it's packed into
+	// the slot of the result. The slot is reserved and its previous copy is finished
+	const auto slot_index = value.slot_index;
+	if (mesh_size > _upload_slots[slot_index].size) {
+		initUploadSlot(slot_index, std::max(mesh_size, _engine_context.chunk_max_current_mesh_size));
+		if (_upload_slots[slot_index].ptr == nullptr) {
+			releaseUploadSlot(slot_index);
+			return false;
 		}
+	}
 
-		memcpy(_staging_buffer_ptr, static_cast<const void*>(value.staging_buffer_ptr.data()), 
-				_engine_context.chunk_max_current_mesh_size);
-		value.staging_buffer_in_use_flag->store(false, std::memory_order_release);
-		glCopyNamedBufferSubData(_staging_buffer_id, _vbo_id, 0, 
-			static_cast<GLintptr>(static_cast<u64>(result.chunk_id) * 
-				_engine_context.chunk_max_current_mesh_size),
-			static_cast<GLintptr>(_engine_context.chunk_max_current_mesh_size)
-		);
-		_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	// NOTE: subregions of spilled mesh differ from the current limits so
+	// offsets are taken from the result
+	auto* dst = static_cast<Vertex*>(_upload_slots[slot_index].ptr);
+	u64 dst_offset{ 0UL };
+	for (std::size_t i{ 0UL }; i < 6UL; ++i) {
+		const auto vertices_count = static_cast<u64>(value.written_quads[i]) * VERTICES_PER_QUAD;
+		memcpy(static_cast<void*>(dst + dst_offset), 
+			static_cast<const void*>(value.staging_buffer_ptr.data() + value.submesh_offsets[i]), 
+			vertices_count * sizeof(Vertex));
+		_polled_submesh_offsets[i] = dst_offset;
+		dst_offset += vertices_count;
 	}
+	_polled_slot = slot_index;
 #ifdef ENGINE_TEST
 	value.cmd_timer_real.stop();
 	result_meshing_time_ns = value.cmd_timer_meshing.duration;
@@ -106,15 +288,89 @@ bool MeshingEngineCPU::pollMeshingCommand(Result& result) noexcept {
 	return true;
 }
 
+void MeshingEngineCPU::uploadMesh(const Result& result, vmath::u64 dst_offset) noexcept {
+	u64 vertices_count{ 0UL };
+	for (const auto written_indices : result.written_indices) {
+		vertices_count += static_cast<u64>(written_indices/6U) * VERTICES_PER_QUAD;
+	}
+	if (vertices_count == 0UL || _polled_slot == INVALID_SLOT) {
+		return;
+	}
+
+	// NOTE: subregions of the slot are sized to the limits, only written vertices of
+	// each face are copied. Ranges adjacent in both the slot and the vbo (eg. packed
+	// spilled mesh) are merged into a single copy
+	const auto buffer_id = _upload_slots[_polled_slot].buffer_id;
+	for (std::size_t i{ 0UL }; i < 6UL; ++i) {
+		const auto size = static_cast<u64>(result.written_indices[i]/6U) * VERTICES_PER_QUAD * sizeof(Vertex);
+		if (size == 0UL) {
+			continue;
+		}
+		const auto src_offset = _polled_submesh_offsets[i] * sizeof(Vertex);
+		if (!_batch_copies.empty()) {
+			auto& last = _batch_copies.back();
+			if (last.buffer_id == buffer_id &&
+				last.src_offset + last.size == src_offset &&
+				last.dst_offset + last.size == dst_offset) {
+				last.size += size;
+				dst_offset += size;
+				continue;
+			}
+		}
+		_batch_copies.push_back(UploadCopy{
+			.buffer_id = buffer_id,
+			.src_offset = src_offset,
+			.dst_offset = dst_offset,
+			.size = size
+		});
+		dst_offset += size;
+	}
+	_uploading_slots.write(_polled_slot);
+	++_batch_slots_count;
+	_polled_slot = INVALID_SLOT;
+}
+
+void MeshingEngineCPU::flushUploads() noexcept {
+	if (_batch_slots_count == 0UL) {
+		return;
+	}
+
+	for (const auto& copy : _batch_copies) {
+		glCopyNamedBufferSubData(copy.buffer_id, _vbo_id,
+			static_cast<GLintptr>(copy.src_offset),
+			static_cast<GLintptr>(copy.dst_offset),
+			static_cast<GLintptr>(copy.size)
+		);
+	}
+	_uploading_batches.write(UploadBatch{
+		.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0),
+		.slots_count = _batch_slots_count
+	});
+	_batch_copies.clear();
+	_batch_slots_count = 0UL;
+}
+
 void MeshingEngineCPU::updateMetadata(vmath::u32 new_vbo_id) noexcept {
-	deinit();
-	init(new_vbo_id);
-	_cpu_mesher.updateLimits();
+	// NOTE: upload slots are resized when they are released and jobs pick
+	// the new limits up when they start, nothing has to be stopped
+	_cpu_mesher.publishLimits();
+	_vbo_id = new_vbo_id;
 }
 
 void MeshingEngineCPU::deinit() noexcept {
-	glUnmapNamedBuffer(_staging_buffer_id);
-	_staging_buffer_ptr = nullptr;
-	glDeleteBuffers(1, &_staging_buffer_id);
-	_staging_buffer_id = 0;
+	// NOTE: jobs write to the mapped upload slots
+	_cpu_mesher.stop();
+	UploadBatch batch{};
+	while (_uploading_batches.read(batch)) {
+		glDeleteSync(static_cast<GLsync>(batch.fence));
+	}
+	for (std::size_t i{ 0UL }; i < _upload_slots.size(); ++i) {
+		if (_upload_slots[i].buffer_id != 0U) {
+			deinitUploadSlot(i);
+		}
+	}
+	_uploading_slots.clear();
+	_batch_copies.clear();
+	_batch_slots_count = 0UL;
+	_polled_slot = INVALID_SLOT;
 }
@@ -2,6 +2,7 @@
 #define VE001_MESHING_ENGINE_CPU_H
 
 #include <thread>
+#include <limits>
 
 #include <vmath/vmath.h>
 
@@ -9,6 +10,7 @@
 #include "engine_context.h"
 #include "shader.h"
 #include "cpu_mesher.h"
+#include "ringbuffer.h"
 #include "meshing_engine_base.h"
 
 #ifdef ENGINE_TEST
@@ -22,20 +24,78 @@ struct MeshingEngineCPU : public MeshingEngineBase {
 
 	struct CommandCPU {
 		ChunkId chunk_id;
-		std::future<CpuMesher::Promise> future;
 	};
-
-	void* _fence{ nullptr };
-
-	void* _staging_buffer_ptr{ nullptr };
-	vmath::u32 _staging_buffer_id{ 0U };
-
-    /// @brief id of buffer holding voxel data for subsequent meshing command execution
+	/// @brief command which couldn't be issued because all of the mesher's result
+	/// slots were taken (eg. by cancelled results which weren't polled yet)
+	struct DeferredCommandCPU {
+		ChunkId chunk_id;
+		vmath::Vec3f32 chunk_position;
+		std::span<const vmath::u16> voxel_data;
+		/// @brief matches <_chunk_id_to_deferral> of the chunk unless
+		/// the command was cancelled
+		vmath::u32 deferral;
+	};
+	/// @brief marks chunk in <_chunk_id_to_handle> which command is deferred
+	static constexpr CpuMesher::Handle DEFERRED_HANDLE{ CpuMesher::Results::INVALID_HANDLE - 1U };
+	/// @brief persistently mapped buffer of a mesher's slot, jobs of the slot write
+	/// meshes straight into it and they are copied to the vbo from it
+	struct UploadSlot {
+		vmath::u32 buffer_id{ 0U };
+		void* ptr{ nullptr };
+		/// @brief size in bytes
+		vmath::u64 size{ 0UL };
+	};
+	/// @brief deferred copy from an upload slot to the vbo (offsets and size in bytes)
+	struct UploadCopy {
+		vmath::u32 buffer_id{ 0U };
+		vmath::u64 src_offset{ 0UL };
+		vmath::u64 dst_offset{ 0UL };
+		vmath::u64 size{ 0UL };
+	};
+	/// @brief copies issued by a single flush, they share the fence
+	struct UploadBatch {
+		void* fence{ nullptr };
+		/// @brief number of slots of the batch in <_uploading_slots>
+		std::size_t slots_count{ 0UL };
+	};
+	static constexpr std::size_t INVALID_SLOT{ std::numeric_limits<std::size_t>::max() };
+
+	/// @brief upload ring, slot per mesher's slot. Slot is given back to the mesher
+	/// after the copy from it is finished (fence of its batch), copies of different
+	/// batches are in flight at once
+	std::vector<UploadSlot> _upload_slots;
+	/// @brief slots which copies weren't finished yet (including the current batch),
+	/// in order of upload
+	RingBuffer<std::size_t> _uploading_slots;
+	/// @brief flushed batches which copies weren't finished yet, in order of flush
+	RingBuffer<UploadBatch> _uploading_batches;
+	/// @brief copies of the current batch, issued by flushUploads
+	std::vector<UploadCopy> _batch_copies;
+	/// @brief number of slots of the current batch (at the end of <_uploading_slots>)
+	std::size_t _batch_slots_count{ 0UL };
+	/// @brief slot of the result returned by the last pollMeshingCommand call, mesh is
+	/// uploaded from it
+	std::size_t _polled_slot{ INVALID_SLOT };
+	/// @brief offsets (in vertices) of faces' subregions of the mesh in <_polled_slot>
+	std::array<vmath::u64, 6> _polled_submesh_offsets{{0}};
+
+    /// @brief id of vbo to which meshes are uploaded (the same vbo as in ChunkPool)
     vmath::u32 _vbo_id{ 0U };
 	/// @brief cpu mesher - performs the meshing work
 	CpuMesher _cpu_mesher;
-    /// @brief buffer of pending meshing commands
-    RingBuffer<CommandCPU> _commands;
+    /// @brief pending meshing commands indexed by handle of their result in cpu mesher's
+    /// result slots. Results are consumed in order of their completion
+    std::vector<CommandCPU> _commands;
+    /// @brief number of issued commands which results weren't consumed yet
+    vmath::u32 _pending_commands_count{ 0U };
+    /// @brief translates chunk id to handle of its pending command's result, used to cancel it
+    /// (DEFERRED_HANDLE if the command waits in <_deferred_commands>)
+    std::vector<CpuMesher::Handle> _chunk_id_to_handle;
+    /// @brief commands waiting for free result slot, in order of issue
+    RingBuffer<DeferredCommandCPU> _deferred_commands;
+    /// @brief counter of chunk's deferrals, entries of <_deferred_commands> which don't
+    /// match it were cancelled (chunk id may be reused while they wait)
+    std::vector<vmath::u32> _chunk_id_to_deferral;
 #ifdef ENGINE_TEST
     vmath::u64 result_meshing_time_ns{ 0UL };
     vmath::u64 result_real_meshing_time_ns{ 0UL };
@@ -45,23 +105,53 @@ struct MeshingEngineCPU : public MeshingEngineBase {
 			vmath::u32 threads_count) noexcept;
 
     void init(vmath::u32 vbo_id) noexcept override;
+
+    /// @brief (re)creates upload slot's buffer of <size> bytes and hands it to the mesher
+    void initUploadSlot(std::size_t slot_index, vmath::u64 size) noexcept;
+    void deinitUploadSlot(std::size_t slot_index) noexcept;
+    /// @brief gives the slot back to the mesher, its buffer is resized
+    /// first if it doesn't match the current limits
+    void releaseUploadSlot(std::size_t slot_index) noexcept;
+    /// @brief releases slots of batches which copies are finished, stops at the first
+    /// pending batch
+    void releaseUploadedSlots() noexcept;
 	
+    /// @brief issues deferred commands until the mesher is full, cancelled ones are dropped
+    void issueDeferredCommands() noexcept;
+    /// @brief defers the command until a result slot is free
+    void deferMeshingCommand(ChunkId chunk_id, vmath::Vec3f32 chunk_position, std::span<const vmath::u16> voxel_data) noexcept;
+
     /// @brief issues meshing command to the engine
     /// @param chunk_id id of processed chunk. Maps to chunk ids in ChunkPool
     /// @param chunk_position chunk position
     /// @param voxel_data pointer to voxel_data based on which the meshing will take place
     void issueMeshingCommand(ChunkId chunk_id, vmath::Vec3f32 chunk_position, std::span<const vmath::u16> voxel_data) noexcept override;
 
+    /// @brief cancels meshing task of the chunk, worker skips or stops meshing
+    /// and the result is dropped
+    void cancelMeshingCommand(ChunkId chunk_id) noexcept override;
+
     /// @brief Function polls for the result from next command. It isn't waiting (the call
     // is non blocking), only checks once.
     /// @param result variable to which the function write result into
     /// @return true if valid value was written into the <future> param false if not
     bool pollMeshingCommand(Result& result) noexcept override;
 
+    /// @brief adds copies of written vertices of each face from the upload slot to the
+    /// current batch, submeshes are packed one after another in the vbo
+    /// @param result result of the last pollMeshingCommand call
+    /// @param dst_offset offset in bytes in the vbo
+    void uploadMesh(const Result& result, vmath::u64 dst_offset) noexcept override;
+
+    /// @brief issues copies of the current batch and fences them with a single fence
+    void flushUploads() noexcept override;
+
     /// @brief updates metadata based on engine context and new vbo id
     /// @param new_vbo_id new vbo id to which to write meshes
     void updateMetadata(vmath::u32 new_vbo_id) noexcept override;
 
+    void updateVbo(vmath::u32 new_vbo_id) noexcept override { _vbo_id = new_vbo_id; }
+
 #ifdef ENGINE_TEST		
 	std::tuple<vmath::u64, vmath::u64, vmath::u64>
 		getBenchmarkData() const noexcept override {
@@ -71,7 +161,7 @@ struct MeshingEngineCPU : public MeshingEngineBase {
 
 #ifdef ENGINE_TEST_NONINTERACTIVE
 	virtual bool idle() const noexcept override {
-		return _commands.empty();
+		return _pending_commands_count == 0U;
 	}
 #endif
     void deinit() noexcept override;
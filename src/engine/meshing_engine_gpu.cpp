@@ -107,23 +107,7 @@ void MeshingEngineGPU::init(u32 vbo_id) noexcept {
     _engine_context.error |= _ssbo_meshing_temp.init();
     _ssbo_meshing_temp.bind(GL_SHADER_STORAGE_BUFFER, VE001_SH_CONFIG_SSBO_BINDING_MESHING_TEMP);
 
-    Descriptor meshing_descriptor = {
-        .vbo_offsets = {  // passed in floats
-            {static_cast<u32>(_engine_context.chunk_max_current_submesh_size/sizeof(f32) * 0UL), 0U, 0U, 0U }, // +x
-            {static_cast<u32>(_engine_context.chunk_max_current_submesh_size/sizeof(f32) * 1UL), 0U, 0U, 0U }, // -x
-            {static_cast<u32>(_engine_context.chunk_max_current_submesh_size/sizeof(f32) * 2UL), 0U, 0U, 0U }, // +y
-            {static_cast<u32>(_engine_context.chunk_max_current_submesh_size/sizeof(f32) * 3UL), 0U, 0U, 0U }, // -y
-            {static_cast<u32>(_engine_context.chunk_max_current_submesh_size/sizeof(f32) * 4UL), 0U, 0U, 0U }, // +z
-            {static_cast<u32>(_engine_context.chunk_max_current_submesh_size/sizeof(f32) * 5UL), 0U, 0U, 0U }  // -z
-        },
-        .max_submesh_size_in_quads = static_cast<u32>(_engine_context.chunk_max_current_submesh_size/(sizeof(Vertex) * 4UL)),
-        .chunk_position = {0.F, 0.F, 0.F},
-        .chunk_size = _engine_context.chunk_size
-    };
-    _ubo_meshing_descriptor.write(static_cast<const void*>(&meshing_descriptor));
-
-    Temp meshing_temp{};
-    _ssbo_meshing_temp.write(static_cast<const void*>(&meshing_temp));
+    applyMetadata();
 
     _meshing_shader.init();
 #ifdef FORCE_USE_SHADER_FROM_SRC
@@ -172,7 +156,12 @@ void MeshingEngineGPU::issueMeshingCommand(ChunkId chunk_id, vmath::Vec3f32 chun
 }
 
 bool MeshingEngineGPU::pollMeshingCommand(Result& result) noexcept {
+    // NOTE: next command is started only after the mesh of
+    // the previous one was uploaded from the scratch buffer
     if (_active_command.fence == nullptr) {
+        if (_commands.read(_active_command)) {
+            firstCommandExec(_active_command);
+        }
         return false;
     }
 
@@ -223,30 +212,66 @@ bool MeshingEngineGPU::pollMeshingCommand(Result& result) noexcept {
 
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VE001_SH_CONFIG_SSBO_BINDING_MESH_DATA, 0);
 
-    if (!result.overflow_flag) {
-        if (_commands.read(_active_command)) {
-            firstCommandExec(_active_command);
+    return true;
+}
+
+void MeshingEngineGPU::uploadMesh(const Result& result, vmath::u64 dst_offset) noexcept {
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    for (std::size_t i{ 0UL }; i < 6UL; ++i) {
+        const auto size = static_cast<u64>(result.written_indices[i]/6U) * VERTICES_PER_QUAD * sizeof(Vertex);
+        if (size == 0UL) {
+            continue;
         }
+        glCopyNamedBufferSubData(_mesh_scratch_buffer_id, _vbo_id, 
+            static_cast<GLintptr>(_scratch_submesh_offsets[i]),
+            static_cast<GLintptr>(dst_offset),
+            static_cast<GLintptr>(size)
+        );
+        dst_offset += size;
+    }
+}
+
+void MeshingEngineGPU::initMeshScratchBuffer() noexcept {
+    if (_mesh_scratch_buffer_id != 0U) {
+        glDeleteBuffers(1, &_mesh_scratch_buffer_id);
+    }
+    glCreateBuffers(1, &_mesh_scratch_buffer_id);
+    glNamedBufferStorage(_mesh_scratch_buffer_id, static_cast<i64>(_scratch_size), nullptr, 0);
+
+    if (glGetError() == GL_OUT_OF_MEMORY) {
+        _engine_context.error |= Error::GPU_ALLOCATION_FAILED;
     }
-    return true;
 }
 
 void MeshingEngineGPU::updateMetadata(vmath::u32 new_vbo_id) noexcept {
     _vbo_id = new_vbo_id;
+    // NOTE: active command (or its mesh waiting in the scratch buffer) uses
+    // current limits, new ones are applied when next command starts
+    _metadata_update_pending = true;
+}
+
+void MeshingEngineGPU::applyMetadata() noexcept {
+    _metadata_update_pending = false;
 
     Descriptor meshing_descriptor = {
-        .vbo_offsets = {  // passed in floats
-            {static_cast<u32>(_engine_context.chunk_max_current_submesh_size/sizeof(f32) * 0UL), 0U, 0U, 0U }, // +x
-            {static_cast<u32>(_engine_context.chunk_max_current_submesh_size/sizeof(f32) * 1UL), 0U, 0U, 0U }, // -x
-            {static_cast<u32>(_engine_context.chunk_max_current_submesh_size/sizeof(f32) * 2UL), 0U, 0U, 0U }, // +y
-            {static_cast<u32>(_engine_context.chunk_max_current_submesh_size/sizeof(f32) * 3UL), 0U, 0U, 0U }, // -y
-            {static_cast<u32>(_engine_context.chunk_max_current_submesh_size/sizeof(f32) * 4UL), 0U, 0U, 0U }, // +z
-            {static_cast<u32>(_engine_context.chunk_max_current_submesh_size/sizeof(f32) * 5UL), 0U, 0U, 0U }  // -z
-        },
-        .max_submesh_size_in_quads = static_cast<u32>(_engine_context.chunk_max_current_submesh_size/(sizeof(Vertex) * 4UL)),
+        .vbo_offsets = {},
+        .max_submesh_sizes_in_quads = {},
         .chunk_position = {0.F, 0.F, 0.F},
         .chunk_size = _engine_context.chunk_size
     };
+    // NOTE: submeshes of faces (+x, -x, +y, -y, +z, -z) are laid out one after another,
+    // offsets are passed in floats
+    _scratch_size = 0UL;
+    for (std::size_t i{ 0UL }; i < 6UL; ++i) {
+        _scratch_submesh_offsets[i] = _scratch_size;
+        meshing_descriptor.vbo_offsets[i][0] = static_cast<u32>(_scratch_size/sizeof(f32));
+        meshing_descriptor.max_submesh_sizes_in_quads[i][0] = 
+            static_cast<u32>(_engine_context.chunk_max_current_submesh_sizes[i]/(sizeof(Vertex) * VERTICES_PER_QUAD));
+        _scratch_size += _engine_context.chunk_max_current_submesh_sizes[i];
+    }
+
+    initMeshScratchBuffer();
+
     _ubo_meshing_descriptor.write(static_cast<const void*>(&meshing_descriptor));
 
     Temp meshing_temp{};
@@ -254,6 +279,10 @@ void MeshingEngineGPU::updateMetadata(vmath::u32 new_vbo_id) noexcept {
 }
 
 void MeshingEngineGPU::firstCommandExec(Command& command) noexcept {
+    if (_metadata_update_pending) {
+        applyMetadata();
+    }
+
 #ifdef ENGINE_TEST
     glQueryCounter(gpu_meshing_time_query, GL_TIMESTAMP);
     glGetQueryObjectui64v(gpu_meshing_time_query, GL_QUERY_RESULT, &begin_meshing_time_ns);
@@ -282,9 +311,9 @@ void MeshingEngineGPU::firstCommandExec(Command& command) noexcept {
 
     glBindBufferRange(
         GL_SHADER_STORAGE_BUFFER, 
-        VE001_SH_CONFIG_SSBO_BINDING_MESH_DATA, _vbo_id,
-        static_cast<GLintptr>(static_cast<u64>(command.chunk_id) * _engine_context.chunk_max_current_mesh_size), 
-        static_cast<GLintptr>(_engine_context.chunk_max_current_mesh_size)
+        VE001_SH_CONFIG_SSBO_BINDING_MESH_DATA, _mesh_scratch_buffer_id,
+        0, 
+        static_cast<GLintptr>(_scratch_size)
     );
 
     command.axis_progress += _engine_context.meshing_axis_progress_step;
@@ -343,4 +372,6 @@ void MeshingEngineGPU::deinit() noexcept {
 #endif
     _ubo_meshing_descriptor.deinit();
     _ssbo_meshing_temp.deinit();
+    glDeleteBuffers(1, &_mesh_scratch_buffer_id);
+    _mesh_scratch_buffer_id = 0U;
 }
@@ -33,8 +33,8 @@ struct MeshingEngineGPU : public MeshingEngineBase {
     struct Descriptor {
         /// @brief offsets of submeshes (constant)
         alignas(16) vmath::u32 vbo_offsets[6][4];
-        /// @brief max submesh size in quads 
-        alignas(16) vmath::u32 max_submesh_size_in_quads;
+        /// @brief max submeshes' sizes in quads (constant)
+        alignas(16) vmath::u32 max_submesh_sizes_in_quads[6][4];
         /// @brief position changes per meshing command (mutable)
         alignas(16) vmath::Vec3f32 chunk_position;
         /// @brief size of a chunk (constant)
@@ -79,6 +79,17 @@ struct MeshingEngineGPU : public MeshingEngineBase {
     GPUBuffer _ssbo_meshing_temp{ sizeof(Temp) };
     /// @brief id of vbo holding meshes (the same vbo as in ChunkPool)
     vmath::u32 _vbo_id{ 0U };
+    /// @brief id of buffer to which the shader writes mesh of the active command, its
+    /// submeshes are in fixed regions of <chunk_max_current_submesh_sizes> and are
+    /// packed into the vbo by uploadMesh
+    vmath::u32 _mesh_scratch_buffer_id{ 0U };
+    /// @brief submeshes' offsets in bytes with which the scratch buffer and descriptor
+    /// were created (limits of the active command)
+    std::array<vmath::u64, 6> _scratch_submesh_offsets{{0UL}};
+    /// @brief size of the scratch buffer in bytes
+    vmath::u64 _scratch_size{ 0UL };
+    /// @brief set if limits changed, they are applied when next command starts
+    bool _metadata_update_pending{ false };
 
     /// @brief buffer of pending meshing commands
     RingBuffer<Command> _commands;
@@ -114,10 +125,24 @@ struct MeshingEngineGPU : public MeshingEngineBase {
     /// @return true if valid value was written into the <future> param false if not
     bool pollMeshingCommand(Result& result) noexcept override;
 
+    /// @brief copies written submeshes from the scratch buffer into the vbo
+    /// @param result result of the last pollMeshingCommand call
+    /// @param dst_offset offset in bytes in the vbo
+    void uploadMesh(const Result& result, vmath::u64 dst_offset) noexcept override;
+
+    /// @brief (re)creates scratch buffer of <_scratch_size>
+    void initMeshScratchBuffer() noexcept;
+
+    /// @brief applies limits from engine context to the scratch buffer and descriptor,
+    /// mustn't be called while a command is executed
+    void applyMetadata() noexcept;
+
     /// @brief updates metadata based on engine context and new vbo id
     /// @param new_vbo_id new vbo id to which to write meshes
     void updateMetadata(vmath::u32 new_vbo_id) noexcept override;
 
+    void updateVbo(vmath::u32 new_vbo_id) noexcept override { _vbo_id = new_vbo_id; }
+
     /// @brief executes command meaning dispatches meshing based on parameters 
     /// in the <command>. It is first execution so the data is passed to the gpu here
     /// @param command command to be executed
@@ -0,0 +1,162 @@
+#ifndef VE001_MPMC_RING_BUFFER_H
+#define VE001_MPMC_RING_BUFFER_H
+
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+#include <vmath/vmath.h>
+
+#include "spin_then_park.h"
+
+namespace ve001 {
+
+/// @brief lock-free bounded multi-producer/multi-consumer ring. Each cell carries
+/// a sequence number telling whether it's ready to be written (sequence == position)
+/// or read (sequence == position + 1), producers and consumers claim positions with
+/// a CAS on their own counter so neither read nor write takes a lock. Only the
+/// optional blocking poll uses a mutex, and only once the ring stays empty
+/// for longer than spin budget
+template<typename T>
+struct MPMCRingBuffer {
+    struct Cell {
+        std::atomic_size_t sequence{ 0UL };
+        T value{};
+    };
+    /// @brief size of a cache line, counters are placed on separate ones
+    static constexpr std::size_t CACHE_LINE_SIZE{ 64UL };
+
+    std::unique_ptr<Cell[]> _cells;
+    std::size_t _capacity{ 0UL };
+    alignas(CACHE_LINE_SIZE) std::atomic_size_t _writer_position{ 0UL };
+    alignas(CACHE_LINE_SIZE) std::atomic_size_t _reader_position{ 0UL };
+    /// @brief number of consumers parked in poll()
+    alignas(CACHE_LINE_SIZE) std::atomic_uint32_t _parked_readers{ 0U };
+    std::mutex _mutex;
+    std::condition_variable _cond_var;
+
+    MPMCRingBuffer() noexcept = default;
+
+    MPMCRingBuffer(std::size_t size) {
+        resize(size);
+    }
+
+    /// @brief reallocates the ring, previous content is dropped. Isn't thread safe
+    void resize(std::size_t new_size) {
+        _cells = std::make_unique<Cell[]>(new_size);
+        _capacity = new_size;
+        clear();
+    }
+
+    bool write(const T& value) noexcept {
+        return tryWrite([&value](T& cell_value) { cell_value = value; });
+    }
+	template<typename ...Args>
+    bool write(Args&& ...args) noexcept {
+        return tryWrite([&args...](T& cell_value) { cell_value = {std::forward<Args>(args)...}; });
+    }
+    bool write(T&& value) noexcept {
+        return tryWrite([&value](T& cell_value) { cell_value = std::move(value); });
+    }
+
+    bool read(T& value) noexcept {
+        if (_capacity == 0UL) {
+            return false;
+        }
+        auto position = _reader_position.load(std::memory_order_relaxed);
+        for (;;) {
+            auto& cell = _cells[position % _capacity];
+            const auto sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position + 1UL);
+            if (difference == 0) {
+                if (_reader_position.compare_exchange_weak(position, position + 1UL, std::memory_order_relaxed)) {
+                    value = std::move(cell.value);
+                    // NOTE: cell becomes writable for the next lap
+                    cell.sequence.store(position + _capacity, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                // NOTE: cell wasn't written yet (or its write is in progress)
+                return false;
+            } else {
+                position = _reader_position.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /// @brief blocking read, spins for <spin_count> iterations and then
+    /// parks until a value is written
+    void poll(T& value, vmath::u32 spin_count = 0U) noexcept {
+        SpinThenPark spinner{ spin_count };
+        while (!read(value)) {
+            if (!spinner.spin()) {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(_mutex);
+            ++_parked_readers;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            _cond_var.wait(lock, [this] { return !empty(); });
+            --_parked_readers;
+            spinner.reset();
+        }
+    }
+
+    /// @brief approximate if called concurrently with reads/writes
+    bool empty() const noexcept {
+        return _reader_position.load(std::memory_order_acquire) ==
+            _writer_position.load(std::memory_order_acquire);
+    }
+
+    /// @brief isn't thread safe
+    void clear() noexcept {
+        for (std::size_t i{ 0UL }; i < _capacity; ++i) {
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        _writer_position.store(0UL, std::memory_order_relaxed);
+        _reader_position.store(0UL, std::memory_order_relaxed);
+    }
+
+    template<typename Assign>
+    bool tryWrite(Assign&& assign) noexcept {
+        if (_capacity == 0UL) {
+            return false;
+        }
+        auto position = _writer_position.load(std::memory_order_relaxed);
+        for (;;) {
+            auto& cell = _cells[position % _capacity];
+            const auto sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+            if (difference == 0) {
+                if (_writer_position.compare_exchange_weak(position, position + 1UL, std::memory_order_relaxed)) {
+                    assign(cell.value);
+                    // NOTE: cell becomes readable
+                    cell.sequence.store(position + 1UL, std::memory_order_release);
+                    break;
+                }
+            } else if (difference < 0) {
+                // NOTE: cell of previous lap wasn't read yet, ring is full
+                return false;
+            } else {
+                position = _writer_position.load(std::memory_order_relaxed);
+            }
+        }
+
+        // NOTE: pairs with the fence in poll(), either reader sees the write
+        // or writer sees the parked reader
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_parked_readers.load(std::memory_order_relaxed) > 0U) {
+            {
+                // NOTE: lock prevents the notification from being lost between
+                // reader's predicate check and its wait
+                std::lock_guard<std::mutex> lock(_mutex);
+            }
+            _cond_var.notify_one();
+        }
+        return true;
+    }
+};
+
+}
+
+#endif
@@ -3,6 +3,7 @@
 #include <exception>
 #include <fstream>
 #include <vector>
+#include <string_view>
 
 #include <glad/glad.h>
 
@@ -29,6 +30,16 @@ static bool createShaderFromSpirv(const std::filesystem::path &path, u32 shader_
 */
 static bool compileShader(const std::filesystem::path &path, u32 shader_id) noexcept;
 
+/// @brief engine's build flags which shaders depend on, injected after #version directive
+/// of shaders compiled from source (binaries are compiled with them by shaders' build)
+#if defined(USE_VERTEX_PULLING)
+static constexpr std::string_view SHADER_DEFINES{ "#define USE_VERTEX_PULLING\n" };
+#elif defined(USE_PACKED_VERTEX)
+static constexpr std::string_view SHADER_DEFINES{ "#define USE_PACKED_VERTEX\n" };
+#else
+static constexpr std::string_view SHADER_DEFINES{ "" };
+#endif
+
 void Shader::init() noexcept {
     _prog_id = glCreateProgram();
 }
@@ -162,8 +173,13 @@ bool compileShader(const std::filesystem::path &path, u32 shader_id) noexcept {
     try {
         std::ifstream stream(path.c_str());
         std::stringstream sstream;
+        bool version_line{ true };
         for (std::string line; std::getline(stream, line);) {
             sstream << line << '\n';
+            if (version_line) {
+                sstream << SHADER_DEFINES;
+                version_line = false;
+            }
         }
         const auto shader_src = sstream.str();
         
@@ -0,0 +1,32 @@
+#include "spin_then_park.h"
+
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#define VE001_CPU_RELAX() _mm_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define VE001_CPU_RELAX() asm volatile("yield")
+#else
+#define VE001_CPU_RELAX() std::this_thread::yield()
+#endif
+
+using namespace ve001;
+using namespace vmath;
+
+/// @brief number of last spin iterations which yield the time slice
+/// instead of pausing the cpu
+static constexpr u32 YIELD_ITERATIONS{ 16U };
+
+bool SpinThenPark::spin() noexcept {
+    if (_iteration >= spin_count) {
+        return true;
+    }
+    if (spin_count - _iteration <= YIELD_ITERATIONS) {
+        std::this_thread::yield();
+    } else {
+        VE001_CPU_RELAX();
+    }
+    ++_iteration;
+    return false;
+}
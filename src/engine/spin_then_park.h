@@ -0,0 +1,26 @@
+#ifndef VE001_SPIN_THEN_PARK_H
+#define VE001_SPIN_THEN_PARK_H
+
+#include <vmath/vmath.h>
+
+namespace ve001 {
+
+/// @brief idle policy of waiting threads. Thread spins (with cpu relax hint) for
+/// <spin_count> iterations before it's allowed to park (block on condition variable,
+/// atomic wait or future), so that work arriving shortly is picked up without the
+/// latency of a wake up while idle thread doesn't burn the core
+struct SpinThenPark {
+    /// @brief number of spins before parking, 0 means park right away
+    vmath::u32 spin_count;
+    vmath::u32 _iteration{ 0U };
+
+    /// @brief performs a single spin iteration
+    /// @return true if spin budget is exhausted and caller should park
+    bool spin() noexcept;
+    /// @brief resets spin budget (eg. after work was found or thread was woken up)
+    void reset() noexcept { _iteration = 0U; }
+};
+
+}
+
+#endif
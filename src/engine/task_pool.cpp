@@ -0,0 +1,235 @@
+#include "task_pool.h"
+
+using namespace ve001;
+using namespace vmath;
+
+/// @brief pool to which calling thread belongs as a worker (nullptr if none)
+static thread_local TaskPool* tl_task_pool{ nullptr };
+/// @brief index of calling thread's worker in <tl_task_pool>
+static thread_local std::size_t tl_worker_index{ 0UL };
+
+bool TaskPool::Worker::pushBack(Task task) noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (size == tasks.size()) {
+        return false;
+    }
+    tasks[(front + size) % tasks.size()] = task;
+    ++size;
+    return true;
+}
+
+bool TaskPool::Worker::popBack(Task& task) noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (size == 0UL) {
+        return false;
+    }
+    --size;
+    task = tasks[(front + size) % tasks.size()];
+    return true;
+}
+
+bool TaskPool::Worker::popFront(Task& task) noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (size == 0UL) {
+        return false;
+    }
+    task = tasks[front];
+    front = (front + 1) % tasks.size();
+    --size;
+    return true;
+}
+
+TaskPool::TaskPool(Error& error, u32 threads_count, u32 idle_spin_count) noexcept 
+    : _error(error), _idle_spin_count(idle_spin_count) {
+    if (threads_count == 0U) {
+        threads_count = std::thread::hardware_concurrency() == 0 ? 1 : std::thread::hardware_concurrency();
+    }
+
+    try {
+        _workers = std::vector<Worker>(threads_count);
+        for (auto& worker : _workers) {
+            worker.tasks.resize(WORKER_QUEUE_CAPACITY);
+        }
+    } catch(const std::exception&) {
+        _error |= Error::CPU_ALLOCATION_FAILED;
+        _workers.clear();
+        return;
+    }
+
+    try {
+        for (std::size_t i{ 0U }; i < _workers.size(); ++i) {
+            _workers[i].jthread = std::jthread(&TaskPool::thread, this, i);
+        }
+    } catch(const std::exception&) {
+        // NOTE: queued tasks are still executed by the waiting threads
+        _error |= Error::TASK_POOL_THREAD_ALLOCATION_FAILED;
+        _done = true;
+    }
+}
+
+void TaskPool::thread(std::size_t worker_index) noexcept {
+    tl_task_pool = this;
+    tl_worker_index = worker_index;
+
+    SpinThenPark spinner{ _idle_spin_count };
+    while (!_done) {
+        if (runPendingTask() || runLaneTask()) {
+            spinner.reset();
+            continue;
+        }
+        if (!spinner.spin()) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(_idle_mutex);
+        ++_idle_workers;
+        _idle_cond_var.wait(lock, [this] { return _queued > 0UL || _done; });
+        --_idle_workers;
+        spinner.reset();
+    }
+}
+
+void TaskPool::submit(TaskGroup& group, Task task) noexcept {
+    task.group = &group;
+    group.pending.fetch_add(1UL, std::memory_order_relaxed);
+
+    // NOTE: counter is incremented ahead so that it never
+    // drops below zero when a task is stolen right after push
+    ++_queued;
+    bool pushed{ false };
+    if (!_workers.empty()) {
+        const auto worker_index = tl_task_pool == this ?
+            tl_worker_index :
+            _next_worker.fetch_add(1UL, std::memory_order_relaxed) % _workers.size();
+        pushed = _workers[worker_index].pushBack(task);
+    }
+
+    if (!pushed) {
+        --_queued;
+        task.function(task.data, task.index);
+        finishTask(group);
+        return;
+    }
+
+    if (_idle_workers > 0U) {
+        {
+            // NOTE: lock prevents the notification from being lost between
+            // worker's predicate check and its wait
+            std::lock_guard<std::mutex> lock(_idle_mutex);
+        }
+        _idle_cond_var.notify_one();
+    }
+}
+
+void TaskPool::post(TaskLane lane, Task task) noexcept {
+    task.group = nullptr;
+    if (_workers.empty() || _done) {
+        task.function(task.data, task.index);
+        return;
+    }
+
+    ++_queued;
+    try {
+        std::lock_guard<std::mutex> lock(_lanes[lane].mutex);
+        _lanes[lane].tasks.push_back(task);
+    } catch(const std::exception&) {
+        --_queued;
+        _error |= Error::CPU_ALLOCATION_FAILED;
+        task.function(task.data, task.index);
+        return;
+    }
+
+    if (_idle_workers > 0U) {
+        {
+            std::lock_guard<std::mutex> lock(_idle_mutex);
+        }
+        _idle_cond_var.notify_one();
+    }
+}
+
+bool TaskPool::runLaneTask() noexcept {
+    for (auto& lane : _lanes) {
+        Task task;
+        {
+            std::lock_guard<std::mutex> lock(lane.mutex);
+            if (lane.tasks.empty()) {
+                continue;
+            }
+            task = lane.tasks.front();
+            lane.tasks.pop_front();
+        }
+        --_queued;
+        task.function(task.data, task.index);
+        return true;
+    }
+    return false;
+}
+
+bool TaskPool::runPendingTask() noexcept {
+    if (_workers.empty()) {
+        return false;
+    }
+
+    Task task;
+    bool found{ false };
+    const bool is_worker = tl_task_pool == this;
+    const auto first_index = is_worker ? tl_worker_index : 0UL;
+    if (is_worker) {
+        found = _workers[first_index].popBack(task);
+    }
+    for (std::size_t i{ 1UL }; !found && i <= _workers.size(); ++i) {
+        found = _workers[(first_index + i) % _workers.size()].popFront(task);
+    }
+    if (!found) {
+        return false;
+    }
+
+    --_queued;
+    task.function(task.data, task.index);
+    finishTask(*task.group);
+    return true;
+}
+
+void TaskPool::finishTask(TaskGroup& group) noexcept {
+    // NOTE: group mustn't be accessed after the last decrement, waiting thread
+    // may already return and destroy it
+    if (group.pending.fetch_sub(1UL) == 1UL && _parked_waiters > 0U) {
+        {
+            std::lock_guard<std::mutex> lock(_groups_mutex);
+        }
+        _groups_cond_var.notify_all();
+    }
+}
+
+void TaskPool::wait(TaskGroup& group) noexcept {
+    SpinThenPark spinner{ _idle_spin_count };
+    while (group.pending.load(std::memory_order_acquire) != 0UL) {
+        if (runPendingTask()) {
+            spinner.reset();
+            continue;
+        }
+        // NOTE: without running workers queued tasks are executed
+        // only by waiting threads, so they never park
+        if (!spinner.spin() || _done) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(_groups_mutex);
+        ++_parked_waiters;
+        _groups_cond_var.wait(lock, [&group] { 
+            return group.pending.load(std::memory_order_acquire) == 0UL; 
+        });
+        --_parked_waiters;
+    }
+}
+
+TaskPool::~TaskPool() noexcept {
+    {
+        std::lock_guard<std::mutex> lock(_idle_mutex);
+        _done = true;
+    }
+    _idle_cond_var.notify_all();
+    for (auto& worker : _workers) {
+        if (worker.jthread.joinable()) {
+            worker.jthread.join();
+        }
+    }
+}
@@ -0,0 +1,143 @@
+#ifndef VE001_TASK_POOL_H
+#define VE001_TASK_POOL_H
+
+#include <vector>
+#include <deque>
+#include <array>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+
+#include <vmath/vmath.h>
+
+#include "enums.h"
+#include "spin_then_park.h"
+
+namespace ve001 {
+
+/// @brief persistent pool of worker threads, it's the only executor of engine's
+/// background work. Each worker owns a deque of fork-join tasks, it pops its own
+/// tasks from the back and steals tasks of other workers from the front. Jobs of
+/// engine's stages are posted to lanes and are picked only if there is no fork-join
+/// task to run, lanes are served in order of their priority
+struct TaskPool {
+    /// @brief counts pending tasks of a single fork-join section
+    struct TaskGroup {
+        std::atomic_size_t pending{ 0UL };
+    };
+    /// @brief type erased task, <data> is owned by the submitting thread
+    /// and has to outlive the task
+    struct Task {
+        void (*function)(void* data, std::size_t index) noexcept{ nullptr };
+        void* data{ nullptr };
+        std::size_t index{ 0UL };
+        TaskGroup* group{ nullptr };
+    };
+    /// @brief bounded deque of tasks belonging to one worker
+    struct Worker {
+        std::mutex mutex;
+        std::vector<Task> tasks;
+        std::size_t front{ 0UL };
+        std::size_t size{ 0UL };
+        std::jthread jthread;
+
+        bool pushBack(Task task) noexcept;
+        bool popBack(Task& task) noexcept;
+        bool popFront(Task& task) noexcept;
+    };
+    /// @brief FIFO queue of stage jobs of a single priority
+    struct Lane {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+    /// @brief capacity of a single worker's deque, if it's full
+    /// the task is executed inline by the submitting thread
+    static constexpr std::size_t WORKER_QUEUE_CAPACITY{ 1024UL };
+
+    Error& _error;
+    /// @brief number of spins of idle workers and waiting threads before they park
+    vmath::u32 _idle_spin_count;
+
+    /// @brief allocated workers
+    std::vector<Worker> _workers;
+    /// @brief lanes of stage jobs indexed by TaskLane
+    std::array<Lane, TASK_LANES_COUNT> _lanes;
+    /// @brief worker to which next task from outside of the pool is pushed
+    std::atomic_size_t _next_worker{ 0UL };
+    /// @brief number of tasks in all of the deques and lanes
+    std::atomic_size_t _queued{ 0UL };
+    /// @brief number of workers waiting for tasks
+    std::atomic_uint32_t _idle_workers{ 0U };
+    /// @brief workers' exit condition
+    std::atomic_bool _done{ false };
+    std::mutex _idle_mutex;
+    std::condition_variable _idle_cond_var;
+    /// @brief number of threads parked in wait()
+    std::atomic_uint32_t _parked_waiters{ 0U };
+    std::mutex _groups_mutex;
+    /// @brief signaled when any group's last task is executed
+    std::condition_variable _groups_cond_var;
+
+    /// @param error engine's error flags
+    /// @param threads_count number of worker threads (engine's thread budget), if 0 then
+    /// the number of threads will be that of the number of CPU threads
+    /// @param idle_spin_count number of spins of idle threads before they park
+    TaskPool(Error& error, vmath::u32 threads_count, vmath::u32 idle_spin_count) noexcept;
+
+    /// @brief workers' entry point
+    void thread(std::size_t worker_index) noexcept;
+
+    /// @brief pushes task to the deque of calling worker or (if called from
+    /// outside of the pool) to the next worker's deque
+    /// @param group group which is signaled when the task is executed
+    void submit(TaskGroup& group, Task task) noexcept;
+    /// @brief posts job of an engine's stage, job is executed once by any worker. If
+    /// pool has no workers the job is executed inline
+    /// @param lane lane deciding the priority of the job
+    void post(TaskLane lane, Task task) noexcept;
+    /// @brief executes a single queued fork-join task (own tasks first, then stolen ones)
+    /// @return true if any task was executed
+    bool runPendingTask() noexcept;
+    /// @brief executes a single job from the highest priority non empty lane
+    /// @return true if any job was executed
+    bool runLaneTask() noexcept;
+    /// @brief signals that task of the group was executed
+    void finishTask(TaskGroup& group) noexcept;
+    /// @brief waits until all tasks of the group are executed, meanwhile
+    /// calling thread executes pending fork-join tasks (but never lanes' jobs,
+    /// so a stage's job doesn't nest inside of another one). If there is nothing
+    /// to help with it spins and then parks until the group is finished
+    void wait(TaskGroup& group) noexcept;
+
+    /// @brief calls function(index) for each index in [0, count), calling thread
+    /// executes first index itself and helps with the rest until all are done
+    /// @param count number of indices
+    /// @param function callable taking std::size_t index
+    template<typename Function>
+    void parallelFor(std::size_t count, Function&& function) noexcept {
+        if (count == 0UL) {
+            return;
+        }
+        using FunctionType = std::remove_reference_t<Function>;
+        TaskGroup group;
+        for (std::size_t i{ 1UL }; i < count; ++i) {
+            submit(group, Task{
+                .function = [](void* data, std::size_t index) noexcept {
+                    (*static_cast<FunctionType*>(data))(index);
+                },
+                .data = const_cast<void*>(static_cast<const void*>(&function)),
+                .index = i
+            });
+        }
+        function(0UL);
+        wait(group);
+    }
+
+    ~TaskPool() noexcept;
+};
+
+}
+
+#endif
@@ -0,0 +1,270 @@
+#include "tlsf_allocator.h"
+
+#include <bit>
+
+using namespace ve001;
+using namespace vmath;
+
+/// @brief size class of the free list to which block of <size> belongs (rounded down)
+static void mappingInsert(u32 size, u32& fl, u32& sl) noexcept {
+    if (size < TLSFAllocator::SL_COUNT) {
+        fl = 0U;
+        sl = size;
+        return;
+    }
+    const auto log2 = static_cast<u32>(std::bit_width(size)) - 1U;
+    fl = log2 - TLSFAllocator::SL_BITS + 1U;
+    sl = (size >> (log2 - TLSFAllocator::SL_BITS)) ^ TLSFAllocator::SL_COUNT;
+}
+
+/// @brief size class from which any free block fits <size> (rounded up)
+static void mappingSearch(u32 size, u32& fl, u32& sl) noexcept {
+    if (size >= TLSFAllocator::SL_COUNT) {
+        const auto log2 = static_cast<u32>(std::bit_width(size)) - 1U;
+        const auto round = (1U << (log2 - TLSFAllocator::SL_BITS)) - 1U;
+        // NOTE: rounding can't overflow past the last class, it would only
+        // make the search fail
+        size = size > std::numeric_limits<u32>::max() - round ? std::numeric_limits<u32>::max() : size + round;
+    }
+    mappingInsert(size, fl, sl);
+}
+
+void TLSFAllocator::init(u32 capacity, u32 max_allocations) {
+    // NOTE: each allocation splits at most one free block, there is at most one free block
+    // between two allocations so the count of nodes is bounded and never reallocated
+    const auto max_blocks = static_cast<std::size_t>(max_allocations) * 2UL + 2UL;
+    _blocks.assign(max_blocks, Block{});
+    _unused_blocks.resize(max_blocks);
+    for (std::size_t i{ 0UL }; i < max_blocks; ++i) {
+        _unused_blocks[i] = static_cast<u32>(max_blocks - 1UL - i);
+    }
+    for (u32 fl{ 0U }; fl < FL_COUNT; ++fl) {
+        _sl_bitmaps[fl] = 0U;
+        for (u32 sl{ 0U }; sl < SL_COUNT; ++sl) {
+            _free_heads[fl][sl] = INVALID_BLOCK;
+        }
+    }
+    _fl_bitmap = 0U;
+    _last_block = INVALID_BLOCK;
+    _capacity = 0U;
+    _used = 0U;
+
+    grow(capacity);
+}
+
+TLSFAllocator::Allocation TLSFAllocator::allocate(u32 size) noexcept {
+    if (size == 0U) {
+        return {};
+    }
+
+    u32 fl{ 0U };
+    u32 sl{ 0U };
+    mappingSearch(size, fl, sl);
+    if (fl >= FL_COUNT) {
+        return {};
+    }
+
+    u32 sl_map = _sl_bitmaps[fl] & (~0U << sl);
+    if (sl_map == 0U) {
+        const u32 fl_map = fl + 1U < FL_COUNT ? _fl_bitmap & (~0U << (fl + 1U)) : 0U;
+        if (fl_map == 0U) {
+            return {};
+        }
+        fl = static_cast<u32>(std::countr_zero(fl_map));
+        sl_map = _sl_bitmaps[fl];
+    }
+    sl = static_cast<u32>(std::countr_zero(sl_map));
+
+    return useFreeBlock(_free_heads[fl][sl], size);
+}
+
+TLSFAllocator::Allocation TLSFAllocator::allocateBelow(u32 size, u32 limit) noexcept {
+    if (size == 0U) {
+        return {};
+    }
+
+    // NOTE: blocks are walked from the end, so the last fitting one is the lowest
+    u32 fitting_block_id{ INVALID_BLOCK };
+    for (auto block_id = _last_block; block_id != INVALID_BLOCK; block_id = _blocks[block_id].prev_physical) {
+        const auto& block = _blocks[block_id];
+        if (block.free && block.size >= size && block.offset + size <= limit) {
+            fitting_block_id = block_id;
+        }
+    }
+    if (fitting_block_id == INVALID_BLOCK) {
+        return {};
+    }
+    return useFreeBlock(fitting_block_id, size);
+}
+
+TLSFAllocator::Allocation TLSFAllocator::useFreeBlock(u32 block_id, u32 size) noexcept {
+    removeFreeBlock(block_id);
+
+    if (_blocks[block_id].size > size) {
+        const auto rest_id = newBlock();
+        if (rest_id == INVALID_BLOCK) {
+            insertFreeBlock(block_id);
+            return {};
+        }
+        auto& block = _blocks[block_id];
+        auto& rest = _blocks[rest_id];
+        rest.offset = block.offset + size;
+        rest.size = block.size - size;
+        rest.prev_physical = block_id;
+        rest.next_physical = block.next_physical;
+        if (rest.next_physical != INVALID_BLOCK) {
+            _blocks[rest.next_physical].prev_physical = rest_id;
+        } else {
+            _last_block = rest_id;
+        }
+        block.next_physical = rest_id;
+        block.size = size;
+        insertFreeBlock(rest_id);
+    }
+
+    _used += size;
+    return { .offset = _blocks[block_id].offset, .block = block_id };
+}
+
+void TLSFAllocator::free(Allocation allocation) noexcept {
+    if (allocation.block == INVALID_BLOCK) {
+        return;
+    }
+
+    auto block_id = allocation.block;
+    _used -= _blocks[block_id].size;
+
+    if (const auto prev_id = _blocks[block_id].prev_physical; prev_id != INVALID_BLOCK && _blocks[prev_id].free) {
+        removeFreeBlock(prev_id);
+        auto& prev = _blocks[prev_id];
+        prev.size += _blocks[block_id].size;
+        prev.next_physical = _blocks[block_id].next_physical;
+        if (prev.next_physical != INVALID_BLOCK) {
+            _blocks[prev.next_physical].prev_physical = prev_id;
+        } else {
+            _last_block = prev_id;
+        }
+        _unused_blocks.push_back(block_id);
+        block_id = prev_id;
+    }
+
+    if (const auto next_id = _blocks[block_id].next_physical; next_id != INVALID_BLOCK && _blocks[next_id].free) {
+        removeFreeBlock(next_id);
+        auto& block = _blocks[block_id];
+        block.size += _blocks[next_id].size;
+        block.next_physical = _blocks[next_id].next_physical;
+        if (block.next_physical != INVALID_BLOCK) {
+            _blocks[block.next_physical].prev_physical = block_id;
+        } else {
+            _last_block = block_id;
+        }
+        _unused_blocks.push_back(next_id);
+    }
+
+    insertFreeBlock(block_id);
+}
+
+void TLSFAllocator::grow(u32 new_capacity) noexcept {
+    if (new_capacity <= _capacity) {
+        return;
+    }
+    const auto extension = new_capacity - _capacity;
+
+    if (_last_block != INVALID_BLOCK && _blocks[_last_block].free) {
+        removeFreeBlock(_last_block);
+        _blocks[_last_block].size += extension;
+        insertFreeBlock(_last_block);
+    } else {
+        const auto block_id = newBlock();
+        if (block_id == INVALID_BLOCK) {
+            return;
+        }
+        auto& block = _blocks[block_id];
+        block.offset = _capacity;
+        block.size = extension;
+        block.prev_physical = _last_block;
+        block.next_physical = INVALID_BLOCK;
+        if (_last_block != INVALID_BLOCK) {
+            _blocks[_last_block].next_physical = block_id;
+        }
+        _last_block = block_id;
+        insertFreeBlock(block_id);
+    }
+    _capacity = new_capacity;
+}
+
+bool TLSFAllocator::shrink(u32 new_capacity) noexcept {
+    if (new_capacity >= _capacity) {
+        return new_capacity == _capacity;
+    }
+    if (_last_block == INVALID_BLOCK || !_blocks[_last_block].free || _blocks[_last_block].offset > new_capacity) {
+        return false;
+    }
+
+    removeFreeBlock(_last_block);
+    if (_blocks[_last_block].offset == new_capacity) {
+        const auto prev_id = _blocks[_last_block].prev_physical;
+        if (prev_id != INVALID_BLOCK) {
+            _blocks[prev_id].next_physical = INVALID_BLOCK;
+        }
+        _unused_blocks.push_back(_last_block);
+        _last_block = prev_id;
+    } else {
+        _blocks[_last_block].size = new_capacity - _blocks[_last_block].offset;
+        insertFreeBlock(_last_block);
+    }
+    _capacity = new_capacity;
+    return true;
+}
+
+u32 TLSFAllocator::newBlock() noexcept {
+    if (_unused_blocks.empty()) {
+        return INVALID_BLOCK;
+    }
+    const auto block_id = _unused_blocks.back();
+    _unused_blocks.pop_back();
+    _blocks[block_id] = Block{};
+    return block_id;
+}
+
+void TLSFAllocator::insertFreeBlock(u32 block_id) noexcept {
+    auto& block = _blocks[block_id];
+    u32 fl{ 0U };
+    u32 sl{ 0U };
+    mappingInsert(block.size, fl, sl);
+
+    block.free = true;
+    block.prev_free = INVALID_BLOCK;
+    block.next_free = _free_heads[fl][sl];
+    if (block.next_free != INVALID_BLOCK) {
+        _blocks[block.next_free].prev_free = block_id;
+    }
+    _free_heads[fl][sl] = block_id;
+    _sl_bitmaps[fl] |= 1U << sl;
+    _fl_bitmap |= 1U << fl;
+}
+
+void TLSFAllocator::removeFreeBlock(u32 block_id) noexcept {
+    auto& block = _blocks[block_id];
+    u32 fl{ 0U };
+    u32 sl{ 0U };
+    mappingInsert(block.size, fl, sl);
+
+    if (block.prev_free != INVALID_BLOCK) {
+        _blocks[block.prev_free].next_free = block.next_free;
+    } else {
+        _free_heads[fl][sl] = block.next_free;
+        if (block.next_free == INVALID_BLOCK) {
+            _sl_bitmaps[fl] &= ~(1U << sl);
+            if (_sl_bitmaps[fl] == 0U) {
+                _fl_bitmap &= ~(1U << fl);
+            }
+        }
+    }
+    if (block.next_free != INVALID_BLOCK) {
+        _blocks[block.next_free].prev_free = block.prev_free;
+    }
+    block.free = false;
+    block.prev_free = INVALID_BLOCK;
+    block.next_free = INVALID_BLOCK;
+}
@@ -0,0 +1,96 @@
+#ifndef VE001_TLSF_ALLOCATOR_H
+#define VE001_TLSF_ALLOCATOR_H
+
+#include <vector>
+#include <limits>
+
+#include <vmath/vmath.h>
+
+namespace ve001 {
+
+/// @brief two-level segregated fit allocator of ranges (offsets) in an externally owned
+/// buffer (eg. gpu buffer). Free blocks are kept in lists segregated by size (first level
+/// is power of two, second level splits it linearly into <SL_COUNT> classes), bitmaps of
+/// non empty lists make both allocation and deallocation O(1). Blocks are split on allocation
+/// to exactly requested size and merged with free physical neighbours on deallocation.
+/// Units of sizes and offsets are up to the user
+struct TLSFAllocator {
+    /// @brief log2 of number of second level classes
+    static constexpr vmath::u32 SL_BITS{ 3U };
+    static constexpr vmath::u32 SL_COUNT{ 1U << SL_BITS };
+    /// @brief first level 0 holds sizes below SL_COUNT linearly
+    static constexpr vmath::u32 FL_COUNT{ 32U - SL_BITS + 1U };
+    static constexpr vmath::u32 INVALID_BLOCK{ std::numeric_limits<vmath::u32>::max() };
+
+    struct Block {
+        vmath::u32 offset{ 0U };
+        vmath::u32 size{ 0U };
+        /// @brief neighbours in the buffer
+        vmath::u32 prev_physical{ INVALID_BLOCK };
+        vmath::u32 next_physical{ INVALID_BLOCK };
+        /// @brief neighbours in the free list of block's size class
+        vmath::u32 prev_free{ INVALID_BLOCK };
+        vmath::u32 next_free{ INVALID_BLOCK };
+        bool free{ false };
+    };
+
+    /// @brief allocated range
+    struct Allocation {
+        vmath::u32 offset{ 0U };
+        /// @brief block of the range, used to free it (INVALID_BLOCK if allocation failed)
+        vmath::u32 block{ INVALID_BLOCK };
+    };
+
+    /// @brief preallocated block nodes, indexed by block id
+    std::vector<Block> _blocks;
+    /// @brief ids of unused nodes in <_blocks>
+    std::vector<vmath::u32> _unused_blocks;
+    /// @brief heads of free lists
+    vmath::u32 _free_heads[FL_COUNT][SL_COUNT];
+    /// @brief bit per first level class which has any non empty free list
+    vmath::u32 _fl_bitmap{ 0U };
+    /// @brief bit per non empty free list of the first level class
+    vmath::u32 _sl_bitmaps[FL_COUNT];
+    /// @brief block at the end of the buffer
+    vmath::u32 _last_block{ INVALID_BLOCK };
+
+    vmath::u32 _capacity{ 0U };
+    vmath::u32 _used{ 0U };
+
+    TLSFAllocator() noexcept = default;
+
+    /// @brief resets allocator to a single free range, previous allocations are dropped
+    /// @param capacity size of the managed range
+    /// @param max_allocations max number of allocations alive at once
+    void init(vmath::u32 capacity, vmath::u32 max_allocations);
+    /// @brief allocates range of exactly <size> units
+    /// @return allocation with INVALID_BLOCK if there is no free range big enough or size is 0
+    Allocation allocate(vmath::u32 size) noexcept;
+    /// @brief allocates range of exactly <size> units which ends below <limit>, the lowest
+    /// fitting free range is taken. Walks all blocks (O(n)), used to compact allocations
+    /// @return allocation with INVALID_BLOCK if there is no such range or size is 0
+    Allocation allocateBelow(vmath::u32 size, vmath::u32 limit) noexcept;
+    /// @brief frees range of the allocation
+    void free(Allocation allocation) noexcept;
+    /// @brief extends managed range at its end, existing allocations are kept
+    /// @param new_capacity has to be bigger than current capacity
+    void grow(vmath::u32 new_capacity) noexcept;
+    /// @brief cuts managed range at its end, possible only if there is no allocation
+    /// past <new_capacity>
+    /// @return true if range was cut
+    bool shrink(vmath::u32 new_capacity) noexcept;
+
+    vmath::u32 capacity() const noexcept { return _capacity; }
+    vmath::u32 size(Allocation allocation) const noexcept { return _blocks[allocation.block].size; }
+    vmath::u32 used() const noexcept { return _used; }
+
+    vmath::u32 newBlock() noexcept;
+    /// @brief takes free block for allocation of <size> units, rest of the block is split off
+    Allocation useFreeBlock(vmath::u32 block, vmath::u32 size) noexcept;
+    void insertFreeBlock(vmath::u32 block) noexcept;
+    void removeFreeBlock(vmath::u32 block) noexcept;
+};
+
+}
+
+#endif
@@ -5,11 +5,48 @@
 
 namespace ve001 {
 
+#if defined(USE_PACKED_VERTEX) || defined(USE_VERTEX_PULLING)
+/// @brief packed vertex of a quad (8 bytes). Position is local to the chunk (chunk's
+/// origin is selected with draw command's base_instance), so chunk extent can't
+/// exceed 64 voxels (corners span 0..64, 7 bits per component)
+/// data[0]: x (bits 0-6), y (bits 7-13), z (bits 14-20), face (bits 21-23)
+/// data[1]: voxel value (bits 0-15), texcoord u (bits 16-22), texcoord v (bits 23-29)
+/// If vertex pulling is used, it's a record of the whole quad expanded by the vertex
+/// shader: position is quad's origin and texcoord is its logical extent (width, height)
+struct Vertex {
+    vmath::u32 data[2];
+};
+
+static_assert(sizeof(Vertex) == 8UL);
+
+/// @param position chunk local position of the vertex
+/// @param texcoord texcoord of the vertex (in voxels)
+inline constexpr Vertex packVertex(vmath::Vec3i32 position, vmath::u32 face, vmath::u16 voxel_value, vmath::Vec2i32 texcoord) noexcept {
+    return Vertex{{
+        static_cast<vmath::u32>(position[0]) | 
+        (static_cast<vmath::u32>(position[1]) << 7U) | 
+        (static_cast<vmath::u32>(position[2]) << 14U) | 
+        (face << 21U),
+        static_cast<vmath::u32>(voxel_value) | 
+        (static_cast<vmath::u32>(texcoord[0]) << 16U) | 
+        (static_cast<vmath::u32>(texcoord[1]) << 23U)
+    }};
+}
+#else
 struct Vertex {
     vmath::Vec3f32 position;
     vmath::Vec3f32 texcoord;
 };
+#endif
+
+#ifdef USE_VERTEX_PULLING
+/// @brief number of vertices stored per quad in vbo
+inline constexpr vmath::u32 VERTICES_PER_QUAD{ 1U };
+#else
+/// @brief number of vertices stored per quad in vbo
+inline constexpr vmath::u32 VERTICES_PER_QUAD{ 4U };
+#endif
 
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -22,10 +22,12 @@ static bool isInBoundingBox(Vec3i32 p0, Vec3i32 p1, Vec3i32 point) noexcept {
 }
 
 static u32 computeMaxVisibleChunks(Vec3i32 chunk_size, Vec3f32 ellipsoid_semi_axes) noexcept {
+    // NOTE: segment of length 2a holds at most floor(2a/c) + 1 chunk origins, otherwise chunks
+    // bigger than the world (eg. 256^3) would give no visible chunk at all
     const auto chunk_size_f32 = Vec3f32::cast(chunk_size);
-    const auto max_chunks_along_x = static_cast<i32>(std::floor((2.F * ellipsoid_semi_axes[0])/chunk_size_f32[0]));
-    const auto max_chunks_along_y = static_cast<i32>(std::floor((2.F * ellipsoid_semi_axes[1])/chunk_size_f32[1]));
-    const auto max_chunks_along_z = static_cast<i32>(std::floor((2.F * ellipsoid_semi_axes[2])/chunk_size_f32[2]));
+    const auto max_chunks_along_x = static_cast<i32>(std::floor((2.F * ellipsoid_semi_axes[0])/chunk_size_f32[0])) + 1;
+    const auto max_chunks_along_y = static_cast<i32>(std::floor((2.F * ellipsoid_semi_axes[1])/chunk_size_f32[1])) + 1;
+    const auto max_chunks_along_z = static_cast<i32>(std::floor((2.F * ellipsoid_semi_axes[2])/chunk_size_f32[2])) + 1;
 
     return max_chunks_along_x * max_chunks_along_y * max_chunks_along_z;
 }
@@ -46,6 +48,7 @@ WorldGrid::WorldGrid(
     if (_engine_context.error == Error::NO_ERROR) {
         try {
             _to_allocate_chunks.resize(_max_visible_chunks);
+            _gen_handle_to_visible_chunk_id.resize(_max_visible_chunks, INVALID_VISIBLE_CHUNK_ID);
         } catch(const std::exception&) {
             _engine_context.error |= Error::CPU_ALLOCATION_FAILED;
         }
@@ -59,17 +62,11 @@ constexpr std::array<Vec3i32, 6> NEIGHBOURS_OFFSETS{{
 }};
 
 void WorldGrid::init() noexcept {
-    while(!_chunk_data_streamer.ready()){}
-
     if (_engine_context.error != Error::NO_ERROR) {
         return;
     }
 
-    const auto chunk_size_f32 = Vec3f32::cast(_engine_context.chunk_size);
-    const auto max_chunks_along_x = static_cast<i32>(std::floor((2.F * _semi_axes[0])/chunk_size_f32[0]));
-    const auto max_chunks_along_y = static_cast<i32>(std::floor((2.F * _semi_axes[1])/chunk_size_f32[1]));
-    const auto max_chunks_along_z = static_cast<i32>(std::floor((2.F * _semi_axes[2])/chunk_size_f32[2]));
-    const auto max_chunks = max_chunks_along_x*max_chunks_along_y*max_chunks_along_z;
+    const auto max_chunks = _max_visible_chunks;
    
     _chunk_pool.init();
 
@@ -82,11 +79,15 @@ void WorldGrid::init() noexcept {
         _visible_chunks.reserve(max_chunks);
         _free_visible_chunk_ids.resize(max_chunks);
         _visible_chunk_id_to_index.resize(max_chunks, INVALID_VISIBLE_CHUNK_INDEX);
+        _visible_chunk_id_to_gen_handle.resize(max_chunks, ChunkDataStreamer::Results::INVALID_HANDLE);
+        _visible_chunk_id_to_generation.resize(max_chunks, 0U);
     } catch (const std::exception&) {
         _engine_context.error |= Error::CPU_ALLOCATION_FAILED;
         return;
     }
 
+    _chunk_data_streamer.updateFocus(_current_position);
+
     u32 i{ 0U };
     for (auto& visible_chunk_id : _free_visible_chunk_ids) {
         visible_chunk_id = i++;
@@ -118,10 +119,7 @@ void WorldGrid::init() noexcept {
     }
 
     for(auto& chunk : _visible_chunks) {
-        _to_allocate_chunks.write({
-            std::move(_chunk_data_streamer.gen(chunk.position_in_chunks)),
-            chunk.visible_chunk_id
-        });
+        requestChunkData(chunk.visible_chunk_id, chunk.position_in_chunks);
         u32 neighbour{ 0U };
         for (const auto neighbour_offset : NEIGHBOURS_OFFSETS) {
             const auto neighbour_position = Vec3i32::add(chunk.position_in_chunks, neighbour_offset);
@@ -141,7 +139,7 @@ void WorldGrid::init() noexcept {
         pollToAllocateChunks();
     }
 
-    while (pollToAllocateChunks()) {}
+    waitToAllocateChunks();
 
     std::fill(_tmp_indices.begin(), _tmp_indices.end(), VisibleChunk::INVALID_NEIGHBOUR_INDEX);
 }
@@ -160,6 +158,8 @@ void WorldGrid::update(Vec3f32 new_position) noexcept {
     }
 
     _current_position = new_position;
+    // NOTE: requests still queued from previous updates are reordered as well
+    _chunk_data_streamer.updateFocus(_current_position);
 
     const auto position_in_chunk_space = Vec3i32::cast(vmath::vroundf(Vec3f32::div(_current_position, Vec3f32::cast(_engine_context.chunk_size))));
     const auto half_grid_size = Vec3i32::divScalar(_grid_size, 2);
@@ -196,10 +196,7 @@ void WorldGrid::update(Vec3f32 new_position) noexcept {
                         _free_visible_chunk_ids.pop_back();
                         _visible_chunk_id_to_index[visible_chunk_id] = visible_neighbour_chunk_index;
                         auto& visible_neighbour_chunk = _visible_chunks.emplace_back(visible_chunk_id, INVALID_CHUNK_ID, neighbour_position_in_chunks);
-                        _to_allocate_chunks.write({
-                            std::move(_chunk_data_streamer.gen(neighbour_position_in_chunks)),
-                            visible_chunk_id
-                        });
+                        requestChunkData(visible_chunk_id, neighbour_position_in_chunks);
 
                         _visible_chunks[i].neighbours_indices[neighbour] = visible_neighbour_chunk_index;
                         ++_visible_chunks[i].neighbours_count;
@@ -282,6 +279,14 @@ void WorldGrid::update(Vec3f32 new_position) noexcept {
                     }
                 }
 
+                // NOTE: chunk's data isn't needed anymore, generation is skipped or stopped
+                // and the result is dropped in pollToAllocateChunks
+                if (auto& handle = _visible_chunk_id_to_gen_handle[chunk.visible_chunk_id]; handle != ChunkDataStreamer::Results::INVALID_HANDLE) {
+                    _chunk_data_streamer._results.cancel(handle);
+                    handle = ChunkDataStreamer::Results::INVALID_HANDLE;
+                }
+                // NOTE: id may be reused in this update, queued allocations of the old chunk become stale
+                ++_visible_chunk_id_to_generation[chunk.visible_chunk_id];
                 _free_visible_chunk_ids.push_back(chunk.visible_chunk_id);
                 _visible_chunk_id_to_index[chunk.visible_chunk_id] = INVALID_VISIBLE_CHUNK_INDEX;
                 _visible_chunks.pop_back();
@@ -298,48 +303,71 @@ void WorldGrid::update(Vec3f32 new_position) noexcept {
         }
     }
 
-    while (pollToAllocateChunks()) {}
+    waitToAllocateChunks();
 
     std::fill(_tmp_indices.begin(), _tmp_indices.end(), VisibleChunk::INVALID_NEIGHBOUR_INDEX);
 }
 
 bool WorldGrid::pollToAllocateChunks() noexcept {
     if (ToAllocateChunk* to_allocate_chunk{ nullptr }; _to_allocate_chunks.peek(to_allocate_chunk) && to_allocate_chunk != nullptr) {
-        if (to_allocate_chunk->data.valid()) {
-            if (to_allocate_chunk->data.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
-                if (const auto visible_chunk_index = _visible_chunk_id_to_index[to_allocate_chunk->visible_chunk_id]; visible_chunk_index != INVALID_VISIBLE_CHUNK_INDEX) {
-                    const auto data = to_allocate_chunk->data.get();
-                    if (data.has_value()) {
-                        const auto chunk_id = _chunk_pool.allocateChunk(data.value(), _visible_chunks[visible_chunk_index].position_in_chunks);
-                        if (chunk_id != INVALID_CHUNK_ID) {
-                            _visible_chunks[visible_chunk_index].chunk_id = chunk_id;
-                        } else {
-                            to_allocate_chunk->ready_data = data.value();
-                        }
-                    }
-                    _to_allocate_chunks.emptyRead();
-                } else {
-                    _to_allocate_chunks.emptyRead();
-                }
-            }
-        } else {
-            if (const auto visible_chunk_index = _visible_chunk_id_to_index[to_allocate_chunk->visible_chunk_id]; visible_chunk_index != INVALID_VISIBLE_CHUNK_INDEX) {
-                if (to_allocate_chunk->ready_data.has_value()) {
-                    const auto chunk_id = _chunk_pool.allocateChunk(to_allocate_chunk->ready_data.value(), _visible_chunks[visible_chunk_index].position_in_chunks);
-                    if (chunk_id != INVALID_CHUNK_ID) {
-                        _visible_chunks[visible_chunk_index].chunk_id = chunk_id;
-                    } 
-                } else {
-                    _to_allocate_chunks.emptyRead();
-                }
-            } else {
-                to_allocate_chunk->ready_data = std::nullopt;
-                _to_allocate_chunks.emptyRead();
+        const auto visible_chunk_index = _visible_chunk_id_to_index[to_allocate_chunk->visible_chunk_id];
+        if (visible_chunk_index != INVALID_VISIBLE_CHUNK_INDEX &&
+            _visible_chunk_id_to_generation[to_allocate_chunk->visible_chunk_id] == to_allocate_chunk->generation) {
+            const auto chunk_id = _chunk_pool.allocateChunk(to_allocate_chunk->ready_data, _visible_chunks[visible_chunk_index].position_in_chunks);
+            if (chunk_id == INVALID_CHUNK_ID) {
+                return true;
             }
+            _visible_chunks[visible_chunk_index].chunk_id = chunk_id;
         }
+        _to_allocate_chunks.emptyRead();
         return true;
-    } 
-    return false;
+    }
+
+    if (ChunkDataStreamer::Handle handle{ ChunkDataStreamer::Results::INVALID_HANDLE }; _chunk_data_streamer._results.pollReady(handle)) {
+        allocateGeneratedChunk(handle);
+    }
+    return _pending_chunks_count > 0U || !_to_allocate_chunks.empty();
+}
+
+void WorldGrid::waitToAllocateChunks() noexcept {
+    while (pollToAllocateChunks()) {
+        if (_to_allocate_chunks.empty() && _pending_chunks_count > 0U) {
+            ChunkDataStreamer::Handle handle{ ChunkDataStreamer::Results::INVALID_HANDLE };
+            _chunk_data_streamer._results.waitReady(handle, _engine_context.idle_spin_count);
+            allocateGeneratedChunk(handle);
+        }
+    }
+}
+
+void WorldGrid::allocateGeneratedChunk(ChunkDataStreamer::Handle handle) noexcept {
+    --_pending_chunks_count;
+    const auto visible_chunk_id = _gen_handle_to_visible_chunk_id[handle];
+    // NOTE: visible chunk id of cancelled request may be already reused by other chunk
+    const bool cancelled = _chunk_data_streamer._results.cancelled(handle);
+    const auto data = _chunk_data_streamer._results.get(handle);
+    if (cancelled) {
+        return;
+    }
+    _visible_chunk_id_to_gen_handle[visible_chunk_id] = ChunkDataStreamer::Results::INVALID_HANDLE;
+
+    const auto visible_chunk_index = _visible_chunk_id_to_index[visible_chunk_id];
+    if (visible_chunk_index == INVALID_VISIBLE_CHUNK_INDEX || !data.has_value()) {
+        return;
+    }
+    const auto chunk_id = _chunk_pool.allocateChunk(data.value(), _visible_chunks[visible_chunk_index].position_in_chunks);
+    if (chunk_id != INVALID_CHUNK_ID) {
+        _visible_chunks[visible_chunk_index].chunk_id = chunk_id;
+    } else {
+        _to_allocate_chunks.write({ visible_chunk_id, _visible_chunk_id_to_generation[visible_chunk_id], data.value() });
+    }
+}
+
+void WorldGrid::requestChunkData(VisibleChunkId visible_chunk_id, Vec3i32 position_in_chunks) noexcept {
+    /// will never fail since streamer's capacity == max chunks count
+    const auto handle = _chunk_data_streamer.gen(position_in_chunks);
+    _visible_chunk_id_to_gen_handle[visible_chunk_id] = handle;
+    _gen_handle_to_visible_chunk_id[handle] = visible_chunk_id;
+    ++_pending_chunks_count;
 }
 
 void WorldGrid::deinit() noexcept {
@@ -46,15 +46,15 @@ struct WorldGrid {
             INVALID_NEIGHBOUR_INDEX
         }};
     };
-    /// @brief handle to chunk which is to be generated and than allocated
+    /// @brief chunk which is generated but couldn't yet be allocated on the chunk pool
     struct ToAllocateChunk {
-        /// @brief handle to data which will be generated in the future by
-        /// chunk data streamer
-        std::future<std::optional<std::span<const vmath::u16>>> data;
         /// @brief handle to visible chunk
         VisibleChunkId visible_chunk_id;
+        /// @brief generation of visible chunk id at the time of queueing, entry is stale
+        /// when the id was freed (and possibly reused) in the meantime
+        vmath::u32 generation;
         /// @brief handle to generated data
-        std::optional<std::span<const vmath::u16>> ready_data{ std::nullopt };
+        std::span<const vmath::u16> ready_data;
     };
 
     /// @brief engine context 
@@ -70,12 +70,23 @@ struct WorldGrid {
     vmath::Vec3i32 _grid_size;
     /// @brief chunk data streamer
     ChunkDataStreamer _chunk_data_streamer;
-    /// @brief queue of chunks to generate and then allocate
+    /// @brief queue of generated chunks for which allocation failed, they are retried
+    /// before next generated chunks are allocated
     RingBuffer<ToAllocateChunk> _to_allocate_chunks;
+    /// @brief translates handle of generation request to visible chunk for which
+    /// it was issued. Results are taken in order of their completion
+    std::vector<VisibleChunkId> _gen_handle_to_visible_chunk_id;
+    /// @brief number of generation requests which results weren't taken yet
+    vmath::u32 _pending_chunks_count{ 0U };
     /// @brief available visible chunks' ids
     std::vector<VisibleChunkId> _free_visible_chunk_ids;
     /// @brief translates visible chunk id to index in visible chunks array
     std::vector<vmath::u32> _visible_chunk_id_to_index;
+    /// @brief translates visible chunk id to handle of its pending generation request,
+    /// used to cancel the request once the chunk stops being visible
+    std::vector<ChunkDataStreamer::Handle> _visible_chunk_id_to_gen_handle;
+    /// @brief translates visible chunk id to its generation, incremented every time the id is freed
+    std::vector<vmath::u32> _visible_chunk_id_to_generation;
     /// @brief array of visible chunks. It is object pooled
     std::vector<VisibleChunk> _visible_chunks;
     /// @brief temporary indices which is a 3d grid of _grid_size. It holds neighbours indices written
@@ -89,7 +100,7 @@ struct WorldGrid {
     /// @param engine_context engine context
     /// @param world_size world size aka semi axes of an ellipsoid
     /// @param initial_position initial world grid continuous in space position (eg. camera initial position)
-    /// @param chunk_data_streamer_threads_count number of <_chunk_data_streamer>'s threads count
+    /// @param chunk_data_streamer_threads_count max number of task pool's workers used by <_chunk_data_streamer> at once
     /// @param chunk_generator chunk generator which will be used by <_chunk_data_streamer>
     WorldGrid(
         EngineContext& engine_context, 
@@ -104,10 +115,19 @@ struct WorldGrid {
     /// Currently it is unsafe to supply position which more than 1 in chunk size units
     /// in any of the axes
     void update(vmath::Vec3f32 new_position) noexcept;
-    /// @brief polls for the chunks which aren't yet generated by chunk data streamer and
-    /// those which are generated but aren't yet allocated on the chunk pool. It is non-blocking
+    /// @brief polls for the chunks which are generated by chunk data streamer but aren't yet
+    /// allocated on the chunk pool, chunks are allocated in order in which their generation
+    /// finished. It is non-blocking
     /// @return true - there are yet chunks to be confirmed generated or allocated on the chunk pool
     bool pollToAllocateChunks() noexcept;
+    /// @brief polls for the chunks to allocate until all of them are allocated. While no
+    /// chunk is generated calling thread spins and then parks on streamer's ready list
+    void waitToAllocateChunks() noexcept;
+    /// @brief takes generated data of completed request and allocates it on the chunk pool
+    /// @param handle handle of completed request taken from streamer's ready list
+    void allocateGeneratedChunk(ChunkDataStreamer::Handle handle) noexcept;
+    /// @brief requests generation of visible chunk's data
+    void requestChunkData(VisibleChunkId visible_chunk_id, vmath::Vec3i32 position_in_chunks) noexcept;
     /// @brief deinitializes all opengl related state (chunk pool)
     void deinit() noexcept;
 };
@@ -1,5 +1,7 @@
 #include "noise_terrain_generator.h"
 
+#include <algorithm>
+
 using namespace ve001;
 using namespace vmath;
 
@@ -29,14 +31,27 @@ bool NoiseTerrainGenerator::threadInit() noexcept {
     return false;
 }
 std::optional<std::span<const vmath::u16>> NoiseTerrainGenerator::gen(vmath::Vec3i32 chunk_position) noexcept {
+    static const std::atomic_bool never_cancelled{ false };
+    return genCancellable(chunk_position, never_cancelled);
+}
+std::optional<std::span<const vmath::u16>> NoiseTerrainGenerator::genCancellable(vmath::Vec3i32 chunk_position, 
+    const std::atomic_bool& cancellation_token) noexcept {
     const auto p0 = Vec3i32::mul(chunk_position, _config.terrain_size);
     const auto p1 = _config.terrain_size;
+    const auto slice_size = static_cast<std::size_t>(p1[0]) * static_cast<std::size_t>(p1[1]);
 
-    _smart_node->GenUniformGrid3D(
-        _tmp_noise.data(), 
-        p0[0], p0[1], p0[2], p1[0], p1[1], p1[2], 
-        _config.noise_frequency, _config.seed
-    );
+    // NOTE: noise is generated in bands of z slices (same values as in one call)
+    // so that the generation stops soon after the chunk is cancelled
+    for (i32 z{ 0 }; z < p1[2]; z += CANCELLATION_CHECK_SLICES) {
+        if (cancellation_token.load(std::memory_order_relaxed)) {
+            return std::nullopt;
+        }
+        _smart_node->GenUniformGrid3D(
+            _tmp_noise.data() + static_cast<std::size_t>(z) * slice_size, 
+            p0[0], p0[1], p0[2] + z, p1[0], p1[1], std::min(CANCELLATION_CHECK_SLICES, p1[2] - z), 
+            _config.noise_frequency, _config.seed
+        );
+    }
 
     auto& buffer = _noise_buffers[_current_buffer];
 
@@ -10,6 +10,8 @@ namespace ve001 {
 
 struct NoiseTerrainGenerator : public ChunkGenerator {
     static constexpr std::size_t BUFFERS_COUNT{ 4UL };
+    /// @brief number of z slices of noise generated between checks of cancellation token
+    static constexpr vmath::i32 CANCELLATION_CHECK_SLICES{ 8 };
 
     static thread_local std::vector<vmath::f32> _tmp_noise;
     static thread_local std::array<std::vector<vmath::u16>, BUFFERS_COUNT> _noise_buffers;
@@ -36,6 +38,8 @@ struct NoiseTerrainGenerator : public ChunkGenerator {
 
     bool threadInit() noexcept override;
     std::optional<std::span<const vmath::u16>> gen(vmath::Vec3i32 chunk_position) noexcept override;
+    std::optional<std::span<const vmath::u16>> genCancellable(vmath::Vec3i32 chunk_position, 
+        const std::atomic_bool& cancellation_token) noexcept override;
 };
 
 }
@@ -29,7 +29,13 @@
 #include <CLI/CLI.hpp>
 
 //////////////////////////////// CONSTANTS //////////////////////////////////
+#if defined(USE_VERTEX_PULLING)
+static constexpr std::string_view vsh_path{ "shaders/bin/basic_test_shader/pulling_vert.spv" };
+#elif defined(USE_PACKED_VERTEX)
+static constexpr std::string_view vsh_path{ "shaders/bin/basic_test_shader/packed_vert.spv" };
+#else
 static constexpr std::string_view vsh_path{ "shaders/bin/basic_test_shader/vert.spv" };
+#endif
 static constexpr std::string_view fsh_path{ "shaders/bin/basic_test_shader/frag.spv" };
 //////////////////////////////////////////////////////////////////////////////
 
@@ -138,10 +144,17 @@ struct CLIAppConfig {
     bool frustum_culling{ false };
     bool back_face_culling{ false };
     vmath::i32 number_of_streamer_threads{ 0 };
+    vmath::i32 number_of_task_pool_threads{ 0 };
+    vmath::i32 idle_spin_count{ 4096 };
     vmath::Vec3f32 world_size{ 100.F, 100.F, 100.F };
     vmath::i32 voxel_states_count; 
     bool use_gpu_meshing_engine{ false };
     vmath::i32 number_of_cpu_mesher_threads{ 2 };
+    vmath::i32 cpu_mesher_slots_per_thread{ 2 };
+    bool use_bitmask_cpu_meshing_kernel{ false };
+    vmath::i32 max_cpu_simd_level{ ve001::CPU_SIMD_LEVEL_AVX2 };
+    vmath::i32 max_chunks_per_frame{ 0 };
+    vmath::i32 poll_budget_us{ 2000 };
 };
 
 #ifdef ENGINE_TEST
@@ -161,13 +174,20 @@ int main(int argc, const char* const* argv) {
 #endif
     app.add_flag("-f,--frustum-culling", cli_app_config.frustum_culling, "turn on frustum culling");
     app.add_flag("-b,--backface-culling", cli_app_config.back_face_culling, "turn on backface culling");
-    app.add_option("-t,--threads-count", cli_app_config.number_of_streamer_threads, "number of threads used by chunk data streamer");
-    app.add_option("-m,--mesher-threads-count", cli_app_config.number_of_cpu_mesher_threads, "number of threads used by cpu mesher");
+    app.add_option("-t,--threads-count", cli_app_config.number_of_streamer_threads, "max number of task pool's threads generating chunks at once (0 - all)");
+    app.add_option("-p,--task-pool-threads-count", cli_app_config.number_of_task_pool_threads, "number of threads used by engine's task pool (0 - number of CPU threads)");
+    app.add_option("-i,--idle-spin-count", cli_app_config.idle_spin_count, "number of spins of idle engine's threads before they park");
+    app.add_option("-m,--mesher-threads-count", cli_app_config.number_of_cpu_mesher_threads, "max number of task pool's threads meshing chunks at once (0 - all)");
+    app.add_option("-u,--mesher-slots-per-thread", cli_app_config.cpu_mesher_slots_per_thread, "number of cpu mesher's slots per meshing thread, each keeps one upload in flight")->check(CLI::Range(1, 64));
     app.add_flag("-g,--use-gpu-meshing", cli_app_config.use_gpu_meshing_engine, "use gpu-based meshing engine");
+    app.add_flag("-k,--bitmask-cpu-meshing", cli_app_config.use_bitmask_cpu_meshing_kernel, "use bitmask-based cpu meshing kernel");
+    app.add_option("-e,--max-cpu-simd-level", cli_app_config.max_cpu_simd_level, "best instruction set used by cpu mesher (0 - scalar, 1 - SSE4.1, 2 - AVX2)")->check(CLI::Range(0, 2));
+    app.add_option("-n,--max-chunks-per-frame", cli_app_config.max_chunks_per_frame, "max number of chunks loaded per frame (0 - no limit)")->check(CLI::NonNegativeNumber);
+    app.add_option("-d,--poll-budget-us", cli_app_config.poll_budget_us, "time spent on loading chunks per frame in microseconds (0 - no limit)")->check(CLI::NonNegativeNumber);
     app.add_option("-w,--voxel-states-count", cli_app_config.voxel_states_count, "number of voxel states used")->required();
-    app.add_option("-x,--chunk-size-x", cli_app_config.chunk_size[0], "size of chunk in X axis")->required();
-    app.add_option("-y,--chunk-size-y", cli_app_config.chunk_size[1], "size of chunk in Y axis")->required();
-    app.add_option("-z,--chunk-size-z", cli_app_config.chunk_size[2], "size of chunk in Z axis")->required();
+    app.add_option("-x,--chunk-size-x", cli_app_config.chunk_size[0], "size of chunk in X axis")->required()->check(CLI::Range(1, ve001::MAX_CHUNK_EXTENT));
+    app.add_option("-y,--chunk-size-y", cli_app_config.chunk_size[1], "size of chunk in Y axis")->required()->check(CLI::Range(1, ve001::MAX_CHUNK_EXTENT));
+    app.add_option("-z,--chunk-size-z", cli_app_config.chunk_size[2], "size of chunk in Z axis")->required()->check(CLI::Range(1, ve001::MAX_CHUNK_EXTENT));
     app.add_option("-X,--world-size-x", cli_app_config.world_size[0], "size of world in X axis")->required();
     app.add_option("-Y,--world-size-y", cli_app_config.world_size[1], "size of world in Y axis")->required();
     app.add_option("-Z,--world-size-z", cli_app_config.world_size[2], "size of world in Z axis")->required();
@@ -215,10 +235,16 @@ int main(int argc, const char* const* argv) {
         ),
 #endif
         .chunk_data_streamer_threads_count = static_cast<vmath::u32>(cli_app_config.number_of_streamer_threads),
+        .task_pool_threads_count = static_cast<vmath::u32>(cli_app_config.number_of_task_pool_threads),
+        .idle_spin_count = static_cast<vmath::u32>(cli_app_config.idle_spin_count),
         .chunk_pool_growth_coefficient = 1.5F,
         .meshing_shader_local_group_size = 64,
 		.use_gpu_meshing_engine = cli_app_config.use_gpu_meshing_engine,
-		.cpu_mesher_threads_count = cli_app_config.number_of_cpu_mesher_threads
+		.cpu_mesher_threads_count = cli_app_config.number_of_cpu_mesher_threads,
+		.cpu_mesher_slots_per_thread = static_cast<vmath::u32>(cli_app_config.cpu_mesher_slots_per_thread),
+		.cpu_meshing_kernel = cli_app_config.use_bitmask_cpu_meshing_kernel ?
+			ve001::CPU_MESHING_KERNEL_BITMASK : ve001::CPU_MESHING_KERNEL_NAIVE,
+		.max_cpu_simd_level = static_cast<ve001::CpuSimdLevel>(cli_app_config.max_cpu_simd_level)
     });
     engine.init();
 
@@ -319,6 +345,8 @@ int main(int argc, const char* const* argv) {
             camera_rotated = false;
         }
 
+        // NOTE: benchmark data describes the last meshed chunk only, chunks are
+        // loaded one per frame when they are sampled
 #ifdef ENGINE_TEST
         if (engine.pollChunksUpdates() && start_testing) {
 			const auto[meshing_time, real_meshing_time, meshing_setup_time] =
@@ -338,7 +366,10 @@ int main(int argc, const char* const* argv) {
 			}
         }
 #else
-        engine.pollChunksUpdates();
+        engine.pollChunksUpdates(
+            static_cast<vmath::u32>(cli_app_config.max_chunks_per_frame),
+            static_cast<vmath::u64>(cli_app_config.poll_budget_us) * 1000UL
+        );
 #endif
 
         engine.updateDrawState();
@@ -355,8 +386,8 @@ int main(int argc, const char* const* argv) {
             testing_context.endMeasure(
                 engine._world_grid._chunk_pool.chunks_used,
                 engine._world_grid._chunk_pool.gpu_memory_usage,
-                engine._world_grid._chunk_pool.chunks_used * engine._engine_context.chunk_max_current_mesh_size,
-                static_cast<vmath::u64>(engine._world_grid._chunk_pool._chunks_count) * engine._engine_context.chunk_max_current_mesh_size,
+                static_cast<vmath::u64>(engine._world_grid._chunk_pool._vbo_allocator.used()) * ve001::ChunkPool::VBO_ALLOCATION_UNIT_SIZE,
+                engine._world_grid._chunk_pool._vbo_size,
                 engine._world_grid._chunk_pool.cpu_active_memory_usage,
                 static_cast<vmath::u64>(engine._world_grid._chunk_pool._chunks_count) * engine._engine_context.chunk_voxel_data_size
             );
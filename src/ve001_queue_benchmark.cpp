@@ -0,0 +1,127 @@
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+
+#include <vmath/vmath.h>
+
+#include <engine/threadsafe_ringbuffer.h>
+#include <engine/mpmc_ringbuffer.h>
+
+#include <CLI/CLI.hpp>
+
+/// contention micro-benchmark of engine's task queues. Producers write
+/// <ops-count> values in total and consumers poll the queue in tight loops
+/// (same access pattern as task pool's workers reading streamer's/mesher's queues)
+
+struct CLIAppConfig {
+    vmath::i32 producers_count{ 1 };
+    vmath::i32 consumers_count{ 4 };
+    vmath::i32 capacity{ 1024 };
+    vmath::i64 ops_count{ 1'000'000 };
+    vmath::i32 repetitions{ 5 };
+};
+
+struct Result {
+    double seconds{ 0.0 };
+    std::uint64_t checksum{ 0UL };
+};
+
+template<typename Queue>
+static Result run(Queue& queue, const CLIAppConfig& config) {
+    const auto producers_count = static_cast<std::uint64_t>(config.producers_count);
+    const auto consumers_count = static_cast<std::uint64_t>(config.consumers_count);
+    const auto ops_count = static_cast<std::uint64_t>(config.ops_count);
+
+    std::atomic_bool start{ false };
+    std::atomic_uint64_t consumed{ 0UL };
+    std::atomic_uint64_t checksum{ 0UL };
+    std::vector<std::jthread> threads;
+
+    for (std::uint64_t p{ 0UL }; p < producers_count; ++p) {
+        threads.emplace_back([&, p] {
+            while (!start) {}
+            for (std::uint64_t i{ p }; i < ops_count; i += producers_count) {
+                while (!queue.write(i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (std::uint64_t c{ 0UL }; c < consumers_count; ++c) {
+        threads.emplace_back([&] {
+            while (!start) {}
+            std::uint64_t local_checksum{ 0UL };
+            std::uint64_t value{ 0UL };
+            while (consumed.load(std::memory_order_relaxed) < ops_count) {
+                if (queue.read(value)) {
+                    local_checksum += value;
+                    consumed.fetch_add(1UL, std::memory_order_relaxed);
+                }
+            }
+            checksum += local_checksum;
+        });
+    }
+
+    const auto begin = std::chrono::steady_clock::now();
+    start = true;
+    threads.clear();
+    const auto end = std::chrono::steady_clock::now();
+
+    return Result{
+        .seconds = std::chrono::duration<double>(end - begin).count(),
+        .checksum = checksum
+    };
+}
+
+template<typename Queue>
+static void benchmark(const char* name, const CLIAppConfig& config) {
+    const auto ops_count = static_cast<std::uint64_t>(config.ops_count);
+    const auto expected_checksum = ops_count * (ops_count - 1UL) / 2UL;
+
+    double best_seconds{ 0.0 };
+    for (vmath::i32 i{ 0 }; i < config.repetitions; ++i) {
+        Queue queue(static_cast<std::size_t>(config.capacity));
+        const auto result = run(queue, config);
+        if (result.checksum != expected_checksum) {
+            std::cerr << name << ": checksum mismatch\n";
+            std::exit(1);
+        }
+        if (i == 0 || result.seconds < best_seconds) {
+            best_seconds = result.seconds;
+        }
+    }
+
+    std::cout << name << ": "
+        << static_cast<double>(ops_count) / best_seconds / 1e6 << " Mops/s (best of "
+        << config.repetitions << ", " << best_seconds * 1e3 << " ms)\n";
+}
+
+int main(int argc, const char* const* argv) {
+    CLI::App app("CLI app for benchmarking engine's task queues under contention", "ve001-queue-benchmark");
+
+    CLIAppConfig cli_app_config{};
+    app.add_option("-p,--producers-count", cli_app_config.producers_count, "number of writing threads");
+    app.add_option("-c,--consumers-count", cli_app_config.consumers_count, "number of polling threads");
+    app.add_option("-s,--capacity", cli_app_config.capacity, "capacity of the queue");
+    app.add_option("-n,--ops-count", cli_app_config.ops_count, "total number of values passed through the queue");
+    app.add_option("-r,--repetitions", cli_app_config.repetitions, "number of repetitions, best one is reported");
+
+    CLI11_PARSE(app, argc, argv);
+
+    if (cli_app_config.producers_count <= 0 || cli_app_config.consumers_count <= 0 ||
+        cli_app_config.capacity <= 0 || cli_app_config.ops_count <= 0 || cli_app_config.repetitions <= 0) {
+        std::cerr << "all arguments have to be positive\n";
+        return 1;
+    }
+
+    std::cout << cli_app_config.producers_count << " producers, "
+        << cli_app_config.consumers_count << " consumers, capacity "
+        << cli_app_config.capacity << '\n';
+
+    benchmark<ve001::ThreadSafeRingBuffer<std::uint64_t>>("mutex ring (ThreadSafeRingBuffer)", cli_app_config);
+    benchmark<ve001::MPMCRingBuffer<std::uint64_t>>("lock-free ring (MPMCRingBuffer)", cli_app_config);
+
+    return 0;
+}